@@ -8,7 +8,8 @@
 //  The volume of background music and FX can be set separately.
 //  The sound playback works "in background" so that the main loop can be
 //  used for other things (LCD, buttons, WiFi etc.) 
-//  Please note that the sampling rate of background music and FX files must be the same.
+//  Please note that the sampling rate of FX files must be the same as the playback rate given in begin().
+//  Background music with a different sampling rate is resampled to the playback rate in the stream task.
 //  Although playSound() can handle different .wav files (eg. 44,1Khz, 16bit, stereo), 
 //  the format 16Khz, mono, 8 bit is recommended (low-bandwidth, low CPU-load).
 //  The provided python scripts can be used to convert arbitrary .wav files to that format.
@@ -21,189 +22,1351 @@
 //  The python script wav2array.py converts .wav files into C-arrays, it creates the header file 
 //  "sounds.h" from one or more .wav files, eg: python raw2array.py sound1.wav sound2.wav sound3.wav
 //  After including "sounds.h" into your sketch, you can use playFX(sound1), playFX(sound2)...
-//  The python script wav2wav.py converts .wav files to 16Khz, mono, 8 bit format.
+//  The python script wav2wav.py converts .wav files to 16Khz, mono, 8 bit format, 
+//  or to IMA-ADPCM format (4 bits per sample) which reduces the SD bandwidth: python wav2wav.py --adpcm file1.wav
 //
-//  The current version of the library uses a timer ISR (called with sampling rate) 
-//  for feeding the sound-samples into the DAC of the ODROID-GO. 
-//  Future improvements might use DMA/I2S to increase performance and sound quality.
+//  Two output modes are available: a timer ISR (called with sampling rate) which 
+//  feeds every single sound-sample into the DAC of the ODROID-GO (SOUND_OUTPUT_TIMER), 
+//  or an output task which renders blocks of samples and hands them to the I2S peripheral
+//  in built-in-DAC mode via DMA (SOUND_OUTPUT_I2S). The I2S mode needs only one interrupt 
+//  per block instead of one per sample.
 //
 //  This code is released under GPLv3 license.
 //  see: https://www.gnu.org/licenses/gpl-3.0.en.html and https://www.fsf.org/
 
 #include <Arduino.h>
 #include "ESP32Sound.h"
+#include "SoundPlatform.h"
 
 // definition/initialisation of the static class members 
 // (the class is a static/singleton!)
-hw_timer_t *      ESP32Sound_Class::timer = NULL;
-QueueHandle_t     ESP32Sound_Class::xQueue = NULL;
+SoundStream       ESP32Sound_Class::stream[SOUND_STREAMS];
+uint8_t           ESP32Sound_Class::current = 0;
+PlaylistEntry     ESP32Sound_Class::playlist[PLAYLIST_SIZE];
+uint8_t           ESP32Sound_Class::playlistHead = 0;
+volatile uint8_t  ESP32Sound_Class::playlistCount = 0;
+uint8_t           ESP32Sound_Class::loopPlaylist = 0;
+volatile uint8_t  ESP32Sound_Class::paused = 0;
+uint8_t           ESP32Sound_Class::streamActive = 0;
 portMUX_TYPE      ESP32Sound_Class::mux = portMUX_INITIALIZER_UNLOCKED;
-TaskHandle_t      ESP32Sound_Class::xHandle = NULL;
-File              ESP32Sound_Class::soundFile;
-volatile uint8_t  ESP32Sound_Class::soundVolume = DEFAULT_SOUND_VOLUME;
-volatile uint8_t  ESP32Sound_Class::fxVolume = DEFAULT_FX_VOLUME;
+SemaphoreHandle_t ESP32Sound_Class::streamLock = NULL;
+TaskHandle_t      ESP32Sound_Class::xOutputHandle = NULL;
+TaskHandle_t      ESP32Sound_Class::xReadHandle = NULL;
+uint16_t          ESP32Sound_Class::prefetchBlock = DEFAULT_PREFETCH_BLOCK;
+SoundPipeline     ESP32Sound_Class::pipeline = { DEFAULT_IO_CORE, DEFAULT_OUTPUT_CORE, DEFAULT_READER_PRIORITY, 
+                                                 DEFAULT_DECODER_PRIORITY, DEFAULT_OUTPUT_PRIORITY };
+volatile uint8_t  ESP32Sound_Class::refillRequest = 0;
+TaskHandle_t      ESP32Sound_Class::xStreamHandle = NULL;
+StaticTask_t      ESP32Sound_Class::streamTaskBuffer;
+StackType_t       ESP32Sound_Class::streamTaskStack[STREAM_TASK_STACK];
+int16_t           ESP32Sound_Class::chunkBuffer[MAX_ADPCM_BLOCK_SAMPLES];
+int16_t           ESP32Sound_Class::resampleBuffer[DEFAULT_CHUNK_SIZE];
+SoundRing<SoundCommand> ESP32Sound_Class::commands;
+SemaphoreHandle_t ESP32Sound_Class::commandLock = NULL;
+uint32_t          ESP32Sound_Class::commandsPosted = 0;
+volatile uint32_t ESP32Sound_Class::commandsApplied = 0;
+soundCallback_t   ESP32Sound_Class::soundCallback = NULL;
+SoundRing<int16_t> ESP32Sound_Class::pushRing;
+volatile uint8_t  ESP32Sound_Class::pushStarted = 0;
+volatile uint8_t  ESP32Sound_Class::pushRanEmpty = 0;
+volatile uint32_t ESP32Sound_Class::pushEmptyMs = 0;
+volatile uint8_t  ESP32Sound_Class::pushRefillWait = 0;
+uint32_t          ESP32Sound_Class::pushRefillLevel = 0;
+soundPullCallback_t ESP32Sound_Class::pullCallback = NULL;
+uint8_t           ESP32Sound_Class::refillLow = DEFAULT_REFILL_LOW;
+uint8_t           ESP32Sound_Class::refillHigh = DEFAULT_REFILL_HIGH;
+volatile uint16_t ESP32Sound_Class::soundGain = volumeToGain(DEFAULT_SOUND_VOLUME);
+volatile uint16_t ESP32Sound_Class::fxGain = volumeToGain(DEFAULT_FX_VOLUME);
+volatile uint16_t ESP32Sound_Class::soundGainRequest = volumeToGain(DEFAULT_SOUND_VOLUME);
+volatile uint16_t ESP32Sound_Class::fxGainRequest = volumeToGain(DEFAULT_FX_VOLUME);
 uint16_t          ESP32Sound_Class::bufsize;
-uint16_t          ESP32Sound_Class::chunksize=DEFAULT_CHUNK_SIZE;
-volatile uint32_t ESP32Sound_Class::sampleCounter;
-volatile uint32_t ESP32Sound_Class::lastSample;
-const uint8_t *   ESP32Sound_Class::playFXLoc = NULL;
-volatile uint32_t ESP32Sound_Class::playFXLen = 0;
-volatile uint8_t  ESP32Sound_Class::playStream = 0;
-uint8_t           ESP32Sound_Class::peak=0;
+uint8_t           ESP32Sound_Class::outputMode=DEFAULT_OUTPUT_MODE;
+uint16_t          ESP32Sound_Class::blocksize=DEFAULT_BLOCK_SIZE;
+FxVoice           ESP32Sound_Class::fxVoice[FX_VOICES];
+uint8_t           ESP32Sound_Class::fxActive = 0;
+volatile uint8_t  ESP32Sound_Class::profiling = 0;
+SoundProfile      ESP32Sound_Class::profile;
+SoundStats        ESP32Sound_Class::stats;
+uint32_t          ESP32Sound_Class::fxSamplesStolen;
+uint8_t           ESP32Sound_Class::stealPolicy = DEFAULT_STEAL_POLICY;
+uint32_t          ESP32Sound_Class::fxStarts = 0;
+uint32_t          ESP32Sound_Class::streamStarts = 0;
+FxEvent           ESP32Sound_Class::fxEvents[FX_EVENTS];
+volatile uint8_t  ESP32Sound_Class::fxEventCount = 0;
+volatile uint32_t ESP32Sound_Class::sampleClock = 0;
+volatile uint32_t ESP32Sound_Class::sampleClockHigh = 0;
+volatile uint32_t ESP32Sound_Class::clockSeq = 0;
+volatile uint32_t ESP32Sound_Class::streamSwitches = 0;
+volatile uint8_t  ESP32Sound_Class::peak=0;
 uint8_t           ESP32Sound_Class::verbosity=1;
-uint16_t          ESP32Sound_Class::channels=1;
-uint16_t          ESP32Sound_Class::bits=8;
-uint32_t          ESP32Sound_Class::samplingRate=16000;
-uint32_t          ESP32Sound_Class::dataStart=0;
-uint32_t          ESP32Sound_Class::dataSize=0;
+uint32_t          ESP32Sound_Class::engineRate=DEFAULT_SAMPLINGRATE;
+uint8_t           ESP32Sound_Class::resampleQuality=DEFAULT_RESAMPLE_QUALITY;
 
+// limit a mix bus value to the 16-bit sample range (compiles to min / max, no branches)
+static inline int32_t IRAM_ATTR saturate16(int32_t v){
+  v = v < -32768 ? -32768 : v;
+  return(v > 32767 ? 32767 : v);
+}
 
-void IRAM_ATTR ESP32Sound_Class::soundTimer(){
+// mix one output sample (used by the timer ISR and by the block renderer).
+// All sources are 16-bit signed samples, they are summed on a 32-bit bus with headroom,
+// saturated once and then quantized to the 8-bit DAC (with dither, see SOUND_DITHER)
+inline uint8_t IRAM_ATTR ESP32Sound_Class::renderSample(){
   uint8_t dacValue=127;
   uint8_t currentAmplitude;
+  int32_t bus=0;
   static uint8_t peakDecayCount=0;
+#if SOUND_DITHER != DITHER_NONE
+  static uint32_t ditherSeed=0x12345678;
+#endif
+#if SOUND_DITHER == DITHER_NOISESHAPE
+  static int32_t quantError=0;
+#endif
 
-  // mix FX samples
-  if (playFXLen) {
-    dacValue+=(*playFXLoc-127)*fxVolume/100;
-    playFXLoc++;
-    playFXLen--;
-  } 
-
-  // mix streaming samples
-  if (playStream) {
-    uint8_t cRxedChar;
-    xQueueReceiveFromISR( xQueue,( void * ) &cRxedChar, NULL);
-    dacValue+=(cRxedChar-127)*soundVolume/100;
-    portENTER_CRITICAL_ISR(&mux);
-    sampleCounter++;
-    if (sampleCounter >= lastSample) {
-      playStream=0;
+  // start the scheduled FX which are due with this sample (one test if none are pending)
+  if (fxEventCount) startFxEvents();
+
+  // mix FX voices
+  int32_t fxMix=0;
+  uint8_t active=0;
+  for (uint8_t i=0; i<FX_VOICES; i++) {
+    FxVoice & v = fxVoice[i];
+    if (v.len) {
+      int32_t s;
+      if (v.format==FX_FORMAT_ADPCM4) {
+        // compressed FX are decoded sample by sample while playing
+        uint8_t b=*v.loc;
+        if (v.nibble) {
+          b>>=4;
+          v.loc++;
+        }
+        v.nibble^=1;
+        s=imaAdpcmDecode(b & 0x0f, v.predictor, v.index);
+      }
+      else s=((int32_t)*v.loc++ - 128) << 8;
+      fxMix+=s*v.gain;
+      v.len--;
+      active++;
+    }
+  }
+  fxActive=active;
+#if SOUND_GAIN_DIVIDE
+  if (active) bus+=fxMix/100*fxGain/100;
+#else
+  if (active) bus+=((fxMix>>GAIN_SHIFT)*fxGain)>>GAIN_SHIFT;
+#endif
+
+  // mix streaming samples, each stream with its own fade gain
+  int32_t streamMix=0;
+  uint8_t streams=0;
+  portENTER_CRITICAL_ISR(&mux);
+  for (uint8_t i=0; (i<SOUND_STREAMS) && (!paused); i++) {
+    SoundStream & s = stream[i];
+    if ((s.playing) && (s.sampleCounter >= s.lastSample)) {
+      s.playing=0;
+      refillRequest=1;     // the stream task closes the file
+      if (s.chained >= 0) {   // start the next file of the playlist with this sample (gapless)
+        SoundStream & n = stream[s.chained];
+        n.queued=0;
+        n.playing=1;
+        current=s.chained;
+        s.chained=-1;
+        __atomic_store_n(&streamSwitches, streamSwitches+1, __ATOMIC_RELEASE);   // see isPlaying()
+      }
+    }
+  }
+  for (uint8_t i=0; (i<SOUND_STREAMS) && (!paused); i++) {
+    SoundStream & s = stream[i];
+    if (!s.playing) continue;
+    int16_t sample;
+    streams++;
+    if (s.ring.read(sample)) {
+      if (s.awaitFirstSample) {
+        stats.startLatencyUs=micros()-s.playStartUs;
+        s.awaitFirstSample=0;
+      }
+      if (s.lastSample==0xffffffff) {   // the end of the file drains the buffer, this is no underrun 
+        uint32_t fill=s.ring.available();
+        if (fill < stats.bufferLow) stats.bufferLow=fill;
+      }
+      streamMix+=sample*(int32_t)(s.fade>>22);
+      s.sampleCounter++;
+    }
+    else if (s.started) stats.underruns++;   // buffer underrun: play silence
+
+    if ((s.refillWait) && (s.ring.available() <= s.refillLevel)) {   // low watermark: wake the stream task
+      s.refillWait=0;
+      refillRequest=1;
+    }
+
+    if (s.fadeLeft) {     // the fade ends after exactly fadeSamples output samples
+      if (--s.fadeLeft) s.fade+=s.fadeStep;
+      else if (s.fadeStep > 0) s.fade=FADE_UNITY;
+      else {    // faded out: the stream task finishes the stream
+        s.fade=0;
+        s.playing=0;
+        if (s.refillWait) {
+          s.refillWait=0;
+          refillRequest=1;
+        }
+      }
     }
-    portEXIT_CRITICAL_ISR(&mux);
   }
-  dacWrite(DAC_PIN, dacValue);
+  portEXIT_CRITICAL_ISR(&mux);
 
-  // update peak value
-  currentAmplitude= dacValue>127 ? dacValue-127 : 127-dacValue;
+  // mix the samples of the application (pushSamples() or pull callback)
+  if ((pushStarted) && (!paused)) {
+    int16_t sample;
+    if (pushRing.read(sample)) {
+      streamMix+=(int32_t)sample<<8;   // at unity fade gain
+      streams++;
+    }
+    else {          // ran empty: the output can stop until new samples are pushed
+      pushStarted=0;
+      if (pushRing.available()) pushStarted=1;    // pushed meanwhile (the producer sets the flag after writing)
+      else if (pullCallback!=NULL) stats.pushUnderruns++;
+      else {        // the producer decides if this was an underrun or the end of a burst
+        pushEmptyMs=millis();
+        pushRanEmpty=1;
+      }
+    }
+    if ((pushRefillWait) && (pushRing.available() <= pushRefillLevel)) {
+      pushRefillWait=0;
+      refillRequest=1;
+    }
+  }
+  streamActive=streams;
+#if SOUND_GAIN_DIVIDE
+  if (streams) bus+=(streamMix>>8)*soundGain/100;
+#else
+  if (streams) bus+=((streamMix>>8)*soundGain)>>GAIN_SHIFT;
+#endif
+
+  stats.samplesRendered++;
+  // the 64-bit sample clock: the upper half only changes when the lower half wraps, 
+  // then the update is wrapped in a seqlock (see getSampleClock64())
+  uint32_t clock=sampleClock+1;
+  if (!clock) {
+    clockSeq++;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    sampleClockHigh++;
+  }
+  __atomic_store_n(&sampleClock, clock, __ATOMIC_RELEASE);
+  if (!clock) __atomic_store_n(&clockSeq, clockSeq+1, __ATOMIC_RELEASE);
+
+  if ((active) || (streams)) {
+    bus=saturate16(bus);
+
+    // quantize to 8 bit: silence is 127, one DAC step is 256 on the bus
+    int32_t w=bus+(127<<8)+128;
+#if SOUND_DITHER != DITHER_NONE
+    ditherSeed^=ditherSeed<<13;    // xorshift32
+    ditherSeed^=ditherSeed>>17;
+    ditherSeed^=ditherSeed<<5;
+    int32_t dither=(int32_t)(ditherSeed & 0xff)-(int32_t)((ditherSeed>>8) & 0xff);   // triangular, +-1 step
+#if SOUND_DITHER == DITHER_NOISESHAPE
+    w-=quantError;                 // first-order error feedback: the noise is moved to high frequencies
+    int32_t q=(w+dither)>>8;
+    quantError=q*256-(w-128);      // the error of the value without the rounding offset (else +0.5 step DC)
+#else
+    int32_t q=(w+dither)>>8;
+#endif
+#else
+    int32_t q=w>>8;
+#endif
+    dacValue = q < 0 ? 0 : (q > 255 ? 255 : q);
+  }
+
+  // update peak value (of the undithered signal)
+  uint32_t amplitude=(bus < 0 ? -bus : bus)>>8;
+  currentAmplitude= amplitude>127 ? 127 : amplitude;
   if (peak < currentAmplitude) peak=currentAmplitude; 
   peakDecayCount++;
   if (peakDecayCount==PEAKDECAY_INTERVAL) {
     peakDecayCount=0;
     if (peak>0) peak--;
   }
+  return(dacValue);
+}
+
+// update the profiling data of the output (timer ISR or block renderer)
+inline void IRAM_ATTR ESP32Sound_Class::profileOutput(uint32_t cycles){
+  uint32_t bucket = cycles/PROFILE_BUCKET_CYCLES;
+  if (bucket >= PROFILE_BUCKETS) bucket=PROFILE_BUCKETS-1;
+  profile.outputHistogram[bucket]++;
+  profile.outputCalls++;
+  profile.outputTotalCycles+=cycles;
+  if (cycles < profile.outputMinCycles) profile.outputMinCycles=cycles;
+  if (cycles > profile.outputMaxCycles) profile.outputMaxCycles=cycles;
+}
+
+void IRAM_ATTR ESP32Sound_Class::soundTimer(){
+  uint32_t start = soundCycleCount();
 
-  // check if we finished playing
-  if ((!playFXLen) && (!playStream) && (!peak)) {
-    dacWrite(DAC_PIN, 127);
-    timerAlarmDisable(timer); 
+  soundDacWrite(renderSample());
+  if (refillRequest) notifyRefill(1);
+
+  // check if we finished playing (the sample clock must keep running for scheduled FX)
+  if ((!fxActive) && (!streamActive) && (!peak) && (!fxEventCount)) {
+    soundDacWrite(127);
+    soundTimerDisable(); 
   }
+  uint32_t cycles = soundCycleCount()-start;
+  if (cycles > stats.outputMaxCycles) stats.outputMaxCycles=cycles;
+  if (profiling) profileOutput(cycles);
+}
+
+bool ESP32Sound_Class::renderBlock(uint8_t * out, uint16_t n){
+  for (uint16_t i=0; i<n; i++) 
+    out[i]=renderSample();
+  if (refillRequest) notifyRefill(0);
+  return ((fxActive) || (streamActive) || (peak) || (fxEventCount));
 }
 
-void ESP32Sound_Class::begin(uint32_t samplingrate, uint16_t soundbufSize)  {
+// the output task for I2S mode: renders blocks and writes them to the DMA buffers
+void ESP32Sound_Class::soundOutputTask( void * parameter )
+{
+    static uint8_t block[MAX_BLOCK_SIZE];
+    static uint16_t frames[MAX_BLOCK_SIZE*2];
 
-    pinMode(AMP_PIN, OUTPUT);
-    digitalWrite(AMP_PIN, HIGH);
-    dacWrite(DAC_PIN, 127);
-    xQueue = xQueueCreate( soundbufSize, 1 );
-    if (verbosity) Serial.printf("Init sound: samplingrate=%d, soundBufsize=%d\n",samplingrate,soundbufSize);
-    bufsize=soundbufSize;
-    timer = timerBegin(0, 80, true);   // prescaler 80 : 1MHz
-    timerAlarmDisable(timer);
-    timerAttachInterrupt(timer, &soundTimer, true);
-    setPlaybackRate(samplingrate);
+    while (1) {
+      uint32_t start = soundCycleCount();
+      if (!renderBlock(block, blocksize)) {
+          // nothing to play: fill all DMA buffers with the DAC midpoint (no pop) 
+          // and sleep until startOutput() is called
+          for (uint16_t i=0; i<blocksize*2; i++) frames[i] = 127<<8;
+          for (uint8_t i=0; i<I2S_DMA_BUFFERS; i++)
+            soundI2SWrite(frames, blocksize);
+          ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+          continue;
+      }
+      // the built-in DAC takes the upper byte of each 16-bit sample, write both channels
+      for (uint16_t i=0; i<blocksize; i++) 
+        frames[2*i] = frames[2*i+1] = ((uint16_t)block[i])<<8;
+      uint32_t cycles = soundCycleCount()-start;
+      if (cycles > stats.outputMaxCycles) stats.outputMaxCycles=cycles;
+      if (profiling) profileOutput(cycles);
+      soundI2SWrite(frames, blocksize);
+    }
 }
 
-void ESP32Sound_Class::playSound(fs::FS &fs, const char * path){
+// wakes the stream task when the mixer requested it (low watermark reached or stream faded out)
+void IRAM_ATTR ESP32Sound_Class::notifyRefill(uint8_t fromIsr){
+  refillRequest=0;
+  if (xStreamHandle==NULL) return;
+  stats.refillWakeups++;
+  if (fromIsr) {
+    BaseType_t woken=pdFALSE;
+    vTaskNotifyGiveFromISR(xStreamHandle, &woken);
+    if (woken) portYIELD_FROM_ISR();
+  }
+  else xTaskNotifyGive(xStreamHandle);    // task context (I2S output task): the scheduler switches if needed
+}
+
+// (re)start output in case it is currently not running
+void ESP32Sound_Class::startOutput(){
+  if (outputMode==SOUND_OUTPUT_I2S) {
+    if (xOutputHandle!=NULL) xTaskNotifyGive(xOutputHandle);
+  }
+  else soundTimerEnable();
+}
+
+void ESP32Sound_Class::begin(uint32_t samplingrate, uint16_t soundbufSize, uint8_t outputmode, uint16_t blockSize)  {
+
+    soundPlatformInit();
+    resetStats();
+    for (uint8_t i=0; i<SOUND_STREAMS; i++) {
+      SoundStream & s = stream[i];
+      s.chained=-1;
+      if (!s.ring.allocate(soundbufSize) || 
+          ((!s.prefetch.size()) && (!s.prefetch.allocate(DEFAULT_PREFETCH_BLOCK*DEFAULT_PREFETCH_BLOCKS)))) {
+          if (verbosity) Serial.println("Init sound: could not allocate sample buffer!");
+          return;
+      }
+    }
+    if ((!pushRing.size()) && (!pushRing.allocate(PUSH_BUFFER_SIZE))) {
+        if (verbosity) Serial.println("Init sound: could not allocate push buffer!");
+        return;
+    }
+    bufsize=stream[0].ring.size();
+    engineRate=samplingrate;
+    outputMode=outputmode;
+    blocksize= blockSize > MAX_BLOCK_SIZE ? MAX_BLOCK_SIZE : blockSize;
+    if (verbosity) Serial.printf("Init sound: samplingrate=%d, soundBufsize=%d, outputMode=%d\n",samplingrate,bufsize,outputMode);
+
+    if (streamLock==NULL) {
+        // one reader task serves all streams, so that SD reads are serialized and interleaved
+        streamLock=xSemaphoreCreateMutex();
+        xTaskCreatePinnedToCore(  soundReadTask,    /* Task function. */
+                      "srt1",           /* String with name of task. */
+                      3000,             /* Stack size in bytes. */
+                      NULL,             /* Parameter passed as input of the task */
+                      pipeline.readerPriority,   /* Priority of the task. */
+                      &xReadHandle,     /* Task handle. */                    
+                      taskCore(pipeline.ioCore));
+        // the stream task lives as long as the application (static stack, no heap fragmentation)
+        commandLock=xSemaphoreCreateMutex();
+        commands.allocate(COMMAND_QUEUE_SIZE);
+        xStreamHandle=xTaskCreateStaticPinnedToCore(  soundStreamTask,  /* Task function. */
+                      "sst1",           /* String with name of task. */
+                      STREAM_TASK_STACK,   /* Stack size in bytes. */
+                      NULL,             /* Parameter passed as input of the task */
+                      pipeline.decoderPriority,   /* Priority of the task. */
+                      streamTaskStack,  /* Stack of the task. */
+                      &streamTaskBuffer,   /* Task control block. */
+                      taskCore(pipeline.ioCore));
+    }
+
+    if (outputMode==SOUND_OUTPUT_I2S) {
+        soundI2SBegin(samplingrate, blocksize);
+        xTaskCreatePinnedToCore(  soundOutputTask,  /* Task function. */
+                      "sot1",           /* String with name of task. */
+                      2048,             /* Stack size in bytes. */
+                      NULL,             /* Parameter passed as input of the task */
+                      pipeline.outputPriority,   /* Priority of the task. */
+                      &xOutputHandle,   /* Task handle. */
+                      taskCore(pipeline.outputCore));
+    }
+    else if ((pipeline.outputCore < 0) || (pipeline.outputCore == xPortGetCoreID())) {
+        soundTimerBegin(&soundTimer, samplingrate);
+    }
+    else {
+        // the timer interrupt is allocated on the core which attaches it: do this in a task on the output core
+        TaskHandle_t caller=xTaskGetCurrentTaskHandle();
+        xTaskCreatePinnedToCore(  timerSetupTask,   /* Task function. */
+                      "sti1",           /* String with name of task. */
+                      2048,             /* Stack size in bytes. */
+                      &caller,          /* Parameter passed as input of the task */
+                      configMAX_PRIORITIES-1,    /* Priority of the task. */
+                      NULL,             /* Task handle. */
+                      pipeline.outputCore);
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+}
+
+// attaches the timer interrupt on the output core, then wakes the caller of begin()
+void ESP32Sound_Class::timerSetupTask(void * parameter){
+    TaskHandle_t caller = *(TaskHandle_t *) parameter;
+    soundTimerBegin(&soundTimer, engineRate);
+    xTaskNotifyGive(caller);
+    vTaskDelete(NULL);
+}
+
+void ESP32Sound_Class::setPipeline(const SoundPipeline & p){
+    pipeline=p;
+}
+
+SoundPipeline ESP32Sound_Class::getPipeline(){
+    return(pipeline);
+}
+
+soundHandle_t ESP32Sound_Class::playSound(fs::FS &fs, const char * path){
     if (isPlaying()) {
       if (verbosity) Serial.printf("sound already playing!\n");
-      return;
+      return(SOUND_NO_HANDLE);
+    }
+    return(startStream(fs, path, 0));
+}
+
+soundHandle_t ESP32Sound_Class::crossfadeTo(fs::FS &fs, const char * path, uint16_t ms){
+    // a file prepared from the playlist is not played after a crossfade.
+    // The streams are stopped without waiting for the stream task (which may wait for an SD read):
+    // the start of the new file is applied after the stop
+    for (uint8_t i=0; i<SOUND_STREAMS; i++)
+      if ((stream[i].queued) && (stream[i].startMode==SOUND_START_CHAIN)) stopStream(stream[i], 0);
+    if (findFreeStream() < 0) {
+      // all streams busy (eg. a crossfade is still running): stop the oldest one 
+      if (verbosity) Serial.println("No free stream, stopping the oldest one.");
+      int8_t oldest=-1;
+      for (uint8_t i=0; i<SOUND_STREAMS; i++)
+        if ((i!=current) && ((oldest<0) || ((int32_t)(stream[i].startNo-stream[oldest].startNo) < 0))) oldest=i;
+      stopStream(stream[oldest], 0);
+    }
+    return(startStream(fs, path, ms));
+}
+
+soundHandle_t ESP32Sound_Class::preload(fs::FS &fs, const char * path){
+    return(startStream(fs, path, 0, SOUND_START_PRELOAD));
+}
+
+boolean ESP32Sound_Class::play(soundHandle_t handle, uint16_t fadeMs){
+    SoundStream * s = getStream(handle);
+    if ((s==NULL) || (s->startMode!=SOUND_START_PRELOAD) || 
+        ((s->state!=SOUND_OPENING) && (s->state!=SOUND_PRELOADED))) {
+      if (verbosity) Serial.println("Not a preloaded file!");
+      return(false);
     }
+    // applied after the file was opened (the commands are processed in order)
+    return(postCommand(SOUND_CMD_PLAY, s-stream, fadeMs, 0));
+}
+
+SoundStream * ESP32Sound_Class::getStream(soundHandle_t handle){
+    if (handle<0) return(NULL);
+    uint8_t i = handle & 0xff;
+    if ((i>=SOUND_STREAMS) || (stream[i].serial != (handle>>8))) return(NULL);
+    return(&stream[i]);
+}
+
+uint8_t ESP32Sound_Class::getSoundState(soundHandle_t handle){
+    SoundStream * s = getStream(handle);
+    if (s==NULL) return(handle<0 ? SOUND_FAILED : SOUND_FINISHED);    // the stream was reused
+    uint8_t state=s->state;
+    if ((state==SOUND_PLAYING) && (!s->playing) && (!s->queued) && (!s->decoding)) return(SOUND_FINISHED);
+    return(state);
+}
+
+void ESP32Sound_Class::setSoundCallback(soundCallback_t callback){
+    soundCallback=callback;
+}
+
+// returns the number of a stream which is not in use, or -1. A stream which is still decoding
+// but stopped can be used: its SOUND_CMD_STOP is applied before the SOUND_CMD_START of the new file
+int8_t ESP32Sound_Class::findFreeStream(){
+    for (uint8_t i=0; i<SOUND_STREAMS; i++) {
+      SoundStream & s = stream[i];
+      if (((!s.decoding) || (s.stopping)) && (!s.playing) && (!s.queued)) return(i);
+    }
+    return(-1);
+}
+
+// reserves a free stream for the file and lets the stream task open and decode it, returns a handle or 
+// SOUND_NO_HANDLE. mode: SOUND_START_PLAY, SOUND_START_CHAIN (started by the mixer when the current 
+// stream ends, see prepareNext) or SOUND_START_PRELOAD (started by play()).
+// Returns at once: the buffers of the stream are reset by the stream task (see SOUND_CMD_START)
+soundHandle_t ESP32Sound_Class::startStream(fs::FS &fs, const char * path, uint32_t fadeMs, uint8_t mode){
+    if (strlen(path) >= PLAYLIST_PATH_LEN) {
+      if (verbosity) Serial.println("Path too long!");
+      return(SOUND_NO_HANDLE);
+    }
+    portENTER_CRITICAL(&mux);             // the reader task may start streams too (prepareNext)
+    int8_t i=findFreeStream();
+    if (i>=0) {
+      SoundStream & s = stream[i];
+      s.queued=1;    // reserved (the reader task may start streams too)
+      s.serial=(s.serial+1) & 0x7f;
+      s.startMode=mode;
+      s.state=SOUND_OPENING;
+    }
+    portEXIT_CRITICAL(&mux);             
+    if (i<0) {
+      if (verbosity) Serial.println("No free stream!");
+      return(SOUND_NO_HANDLE);
+    }
+    SoundStream & s = stream[i];
  
-    setPlaying(1);
-    soundFile = fs.open(path);   
-    if(soundFile){
-        if (verbosity) Serial.printf("open file %s successful!\n", path);
-        if (getWavHeader()) {
-            if (verbosity) Serial.println("Wav file opened.");
-            setPlaybackRate(samplingRate);
-        } else {
-            if (verbosity) Serial.println("Wav format not recognized, assuming raw 8-bit 16Khz format.");
-            channels=1;
-            bits=8;
-            dataStart=0;
-            dataSize=soundFile.size();
+    s.fs=&fs;
+    strcpy(s.path, path);
+    s.playStartUs=micros();
+    s.awaitFirstSample=(mode==SOUND_START_PLAY);
+    s.chained=-1;
+    s.startNo=streamStarts++;
+    if (!postCommand(SOUND_CMD_START, i, fadeMs, 0)) {
+        if (verbosity) Serial.println("Stream task not running!");
+        s.state=SOUND_FAILED;
+        s.queued=0;
+        return(SOUND_NO_HANDLE);
+    }
+    return((soundHandle_t)(s.serial<<8 | i));
+}
+
+// called by the stream task: opens the file of stream s and parses its header, returns 0 if this failed
+uint8_t ESP32Sound_Class::openStream(SoundStream & s){
+    s.file = s.fs->open(s.path);   
+    if(!s.file){
+        if (verbosity) Serial.println("Failed to open file for reading");
+        return(0);
+    }
+    if (verbosity) Serial.printf("open file %s successful!\n", s.path);
+    if (getWavHeader(s)) {
+        if (verbosity) Serial.println("Wav file opened.");
+    } else {
+        if (verbosity) Serial.println("Wav format not recognized, assuming raw 8-bit format at playback rate.");
+        s.format=WAV_FORMAT_PCM;
+        s.channels=1;
+        s.bits=8;
+        s.samplingRate=engineRate;
+        s.dataStart=0;
+        s.dataSize=s.file.size();
+        s.frames=0xffffffff;
+        s.file.seek(0);
+    }
+    if (!selectDecoder(s)) {
+        if (verbosity) Serial.printf("Wav format not supported (format %d, %d bits, %d channels)!\n", s.format, s.bits, s.channels);
+        s.file.close();
+        return(0);
+    }
+    s.resampler.setup(s.samplingRate, engineRate, resampleQuality);
+    s.sampleCounter=0;
+    s.lastSample=0xffffffff;   // the exact number of samples is known when the file is finished
+    s.startSample=0;
+    s.written=0;
+    s.writeLimit=(s.frames==0xffffffff) ? 0xffffffff : (uint64_t)s.frames*engineRate/s.samplingRate;
+    s.firstChunk=1;
+    xSemaphoreTake(streamLock, portMAX_DELAY);
+    s.readPos=s.dataStart;
+    s.readDone=(s.dataSize==0);
+    s.readLen=s.dataSize;
+    xSemaphoreGive(streamLock);
+    return(1);
+}
+
+// called by the stream task: starts the preloaded stream s, the other music is stopped or faded out
+void ESP32Sound_Class::playPreloaded(SoundStream & s, uint16_t fadeMs){
+    if ((s.state!=SOUND_PRELOADED) || (!s.queued)) return;
+    portENTER_CRITICAL(&mux);             
+    for (uint8_t i=0; i<SOUND_STREAMS; i++) {
+      SoundStream & o = stream[i];
+      o.chained=-1;
+      if ((o.queued) && (o.startMode==SOUND_START_CHAIN)) o.queued=0;   // prepared from the playlist
+    }
+    s.fade=fadeMs ? 0 : FADE_UNITY;
+    s.fadeSamples=(uint64_t)fadeMs*engineRate/1000;
+    s.playStartUs=micros();
+    s.awaitFirstSample=1;
+    s.queued=0;
+    s.playing=1;
+    s.state=SOUND_PLAYING;
+    current=&s-stream;
+    portEXIT_CRITICAL(&mux);             
+    startFade(s);     // stops the other streams, or fades them out
+    startOutput();
+}
+
+// called by the reader task: opens the next file of the playlist ahead of time, 
+// so that its header is parsed and its first samples are decoded when the current file ends
+void ESP32Sound_Class::prepareNext(){
+    uint8_t playing=0;
+    PlaylistEntry e;
+
+    for (uint8_t i=0; i<SOUND_STREAMS; i++) {
+      if ((stream[i].queued) && (stream[i].startMode!=SOUND_START_PRELOAD)) return;     // already prepared
+      playing|=stream[i].playing;
+    }
+    // not during a crossfade
+    if ((playing) && ((!stream[current].playing) || (stream[current].fadeLeft))) return;
+    if (findFreeStream() < 0) return;
+
+    portENTER_CRITICAL(&mux);             
+    if (!playlistCount) {      // cleared by stopSound()
+      portEXIT_CRITICAL(&mux);             
+      return;
+    }
+    e=playlist[playlistHead];
+    playlistHead=(playlistHead+1) % PLAYLIST_SIZE;
+    playlistCount--;
+    portEXIT_CRITICAL(&mux);             
+
+    if ((startStream(*e.fs, e.path, 0, playing ? SOUND_START_CHAIN : SOUND_START_PLAY) != SOUND_NO_HANDLE) && (loopPlaylist)) {
+      portENTER_CRITICAL(&mux);             
+      if (playlistCount < PLAYLIST_SIZE) {
+        playlist[(playlistHead+playlistCount) % PLAYLIST_SIZE]=e;
+        playlistCount++;
+      }
+      portEXIT_CRITICAL(&mux);             
+    }
+}
+
+boolean ESP32Sound_Class::enqueue(fs::FS &fs, const char * path){
+    uint8_t ok=0;
+    if (strlen(path) >= PLAYLIST_PATH_LEN) {
+      if (verbosity) Serial.println("Path too long for the playlist!");
+      return(false);
+    }
+    portENTER_CRITICAL(&mux);             
+    if (playlistCount < PLAYLIST_SIZE) {
+      PlaylistEntry & e = playlist[(playlistHead+playlistCount) % PLAYLIST_SIZE];
+      e.fs=&fs;
+      strcpy(e.path, path);
+      playlistCount++;
+      ok=1;
+    }
+    portEXIT_CRITICAL(&mux);             
+    if (!ok) {
+      if (verbosity) Serial.println("Playlist full!");
+      return(false);
+    }
+    if (xReadHandle!=NULL) xTaskNotifyGive(xReadHandle);   // the reader task starts the file
+    return(true);
+}
+
+// the mixer skips all streams while paused, the stream tasks stop when the sample buffers are full
+void ESP32Sound_Class::pause(){
+    paused=1;
+}
+
+void ESP32Sound_Class::resume(){
+    paused=0;
+    startOutput();   // in case output was stopped
+}
+
+boolean ESP32Sound_Class::isPaused(){
+    return(paused!=0);
+}
+
+// the stream task seeks between two chunks, so that no SD read or decoding is interrupted
+boolean ESP32Sound_Class::seekToSample(uint32_t n){
+    if (!postCommand(SOUND_CMD_SEEK, current, n, 1)) {
+      if (verbosity) Serial.println("Seek not possible!");
+      return(false);
+    }
+    return(true);
+}
+
+// called by the stream task: continues stream s at sample frame n, returns 0 if not possible
+uint8_t ESP32Sound_Class::seekStream(SoundStream & s, uint32_t n){
+    uint32_t block = n/s.unitSamples;      // whole frames / ADPCM blocks only
+    uint32_t offset = block*s.unitBytes;
+    uint8_t ok=0;
+
+    xSemaphoreTake(streamLock, portMAX_DELAY);
+    if ((s.playing) && (s.file) && (offset < s.dataSize) && (s.file.seek(s.dataStart+offset))) {
+      portENTER_CRITICAL(&mux);             
+      s.playing=0;      // the mixer does not read the sample buffer now
+      s.refillWait=0;
+      portEXIT_CRITICAL(&mux);             
+      stats.samplesDropped+=s.ring.available();
+      s.ring.reset();
+      s.prefetch.reset();    // the reader task does not read this stream (streamLock)
+      s.resampler.setup(s.samplingRate, engineRate, resampleQuality);
+      s.readPos=s.dataStart+offset;
+      s.readLen=s.dataSize-offset;
+      s.readDone=0;
+      s.started=0;
+      s.sampleCounter=0;
+      s.lastSample=0xffffffff;
+      s.startSample=block*s.unitSamples;
+      s.decoding=1;
+      s.firstChunk=1;
+      s.chainStart=0;
+      s.written=0;
+      if (s.frames!=0xffffffff) 
+        s.writeLimit=(s.frames > s.startSample) ? (uint64_t)(s.frames-s.startSample)*engineRate/s.samplingRate : 0;
+      s.playing=1;
+      ok=1;
+    }
+    xSemaphoreGive(streamLock);
+    if (ok) xTaskNotifyGive(xReadHandle);
+    return(ok);
+}
+
+// the sample counter is only written by the mixer, so it can be read without a lock
+uint32_t ESP32Sound_Class::getPositionSamples(){
+    SoundStream & s = stream[current];
+    return(s.startSample + (uint64_t)s.sampleCounter*s.samplingRate/engineRate);
+}
+
+void ESP32Sound_Class::setLoop(boolean loop){
+    loopPlaylist=loop;
+}
+
+void ESP32Sound_Class::next(){
+    SoundStream & s = stream[current];
+    portENTER_CRITICAL(&mux);             
+    if (s.chained >= 0) {    // switch to the prepared file immediately
+      SoundStream & n = stream[s.chained];
+      s.playing=0;
+      n.queued=0;
+      n.playing=1;
+      current=s.chained;
+      s.chained=-1;
+      __atomic_store_n(&streamSwitches, streamSwitches+1, __ATOMIC_RELEASE);
+    }
+    portEXIT_CRITICAL(&mux);             
+    stopStream(s);     // otherwise the reader task starts the next file
+    if (xReadHandle!=NULL) xTaskNotifyGive(xReadHandle);
+}
+
+// starts the crossfade when the first samples of the new stream s are ready,
+// so that fade in and fade out begin with the same output sample
+void ESP32Sound_Class::startFade(SoundStream & s){
+    portENTER_CRITICAL(&mux);             
+    for (uint8_t i=0; i<SOUND_STREAMS; i++) {
+      SoundStream & o = stream[i];
+      if ((&o==&s) || (!o.playing)) continue;
+      if (!s.fadeSamples) o.playing=0;
+      else {
+        o.fadeStep = -(int32_t)(o.fade/s.fadeSamples);
+        o.fadeLeft = s.fadeSamples;
+      }
+    }
+    if (s.fadeSamples) {
+      s.fadeStep = FADE_UNITY/s.fadeSamples;
+      s.fadeLeft = s.fadeSamples;
+    }
+    portEXIT_CRITICAL(&mux);             
+}
+
+// stops a stream immediately (the mixer does not play it any more), the stream task stops 
+// decoding and closes the file (wait: before this returns)
+void ESP32Sound_Class::stopStream(SoundStream & s, uint8_t wait){
+    portENTER_CRITICAL(&mux);             
+    s.playing=0;
+    s.queued=0;
+    s.stopping=1;
+    s.chained=-1;
+    if (s.state!=SOUND_FAILED) s.state=SOUND_FINISHED;
+    for (uint8_t i=0; i<SOUND_STREAMS; i++)
+      if (stream[i].chained == &s-stream) stream[i].chained=-1;
+    portEXIT_CRITICAL(&mux);             
+    if (!postCommand(SOUND_CMD_STOP, &s-stream, 0, wait)) {
+      xSemaphoreTake(streamLock, portMAX_DELAY);
+      s.readLen=0;
+      s.file.close();
+      xSemaphoreGive(streamLock);
+      s.stopping=0;
+    }
+}
+
+// posts a command to the stream task. wait: returns when the command was applied, with its result.
+// returns 0 if the stream task is not running or the command ring is full.
+// commandLock is only held while the command is written, so that a caller which waits (eg. for a 
+// seek behind a slow SD read) does not block the other callers.
+// Called by the stream task itself (from the sound callback or the pull callback), the command is 
+// applied at once: the task cannot wait for itself
+uint8_t ESP32Sound_Class::postCommand(uint8_t type, uint8_t stream, uint32_t value, uint8_t wait){
+    SoundCommand c;
+    uint8_t result=1;
+
+    if (xStreamHandle==NULL) return(0);
+    c.type=type;
+    c.stream=stream;
+    c.value=value;
+    c.waiter=NULL;
+    c.result=NULL;
+    if (xTaskGetCurrentTaskHandle()==xStreamHandle) return(applyCommand(c));
+    if (wait) {
+      c.waiter=xTaskGetCurrentTaskHandle();
+      c.result=&result;
+    }
+    xSemaphoreTake(commandLock, portMAX_DELAY);
+    if (!commands.write(&c, 1)) {
+      xSemaphoreGive(commandLock);
+      if (verbosity) Serial.println("Command queue full!");
+      return(0);
+    }
+    uint32_t seq=++commandsPosted;
+    xSemaphoreGive(commandLock);
+    xTaskNotifyGive(xStreamHandle);
+    if (wait) 
+      while ((int32_t)(__atomic_load_n(&commandsApplied, __ATOMIC_ACQUIRE)-seq) < 0) ulTaskNotifyTake(pdTRUE, WAIT_FOR_QUEUESPACE);
+    return(result);
+}
+
+// called by the stream task between two chunks, returns the result of the command
+uint8_t ESP32Sound_Class::applyCommand(const SoundCommand & c){
+    SoundStream & s = stream[c.stream];
+    uint8_t result=1;
+    switch (c.type) {
+      case SOUND_CMD_START:
+        if (s.stopping) break;    // stopped before it was opened (the stream may be reserved again, its START follows)
+        if (!s.queued) {          // stopped before it was opened
+          s.state=SOUND_FINISHED;
+          break;
         }
-        xTaskCreate(  soundStreamTask,  /* Task function. */
-                      "sst1",           /* String with name of task. */
-                      4000,             /* Stack size in bytes. */
-                      NULL,             /* Parameter passed as input of the task */
-                      1,                /* Priority of the task. */
-                      &xHandle);        /* Task handle. */                    
-    } 
-    else if (verbosity) {
-        Serial.println("Failed to open file for reading");
-        setPlaying(0);             
+        s.ring.reset();           // the ISR does not read the ring while the stream is not playing
+        s.prefetch.reset();       // ADPCM blocks must start at offset 0 (see selectDecoder)
+        s.readDone=0;
+        s.started=0;
+        s.fade=c.value ? 0 : FADE_UNITY;
+        s.fadeStep=0;
+        s.fadeLeft=0;
+        s.fadeSamples=(uint64_t)c.value*engineRate/1000;
+        if (!openStream(s)) {
+          portENTER_CRITICAL(&mux);             
+          if (s.stopping) {       // stopped while the file was opened (SD access)
+            portEXIT_CRITICAL(&mux);             
+            break;
+          }
+          s.queued=0;
+          portEXIT_CRITICAL(&mux);             
+          s.state=SOUND_FAILED;
+        }
+        else {
+          portENTER_CRITICAL(&mux);             
+          if (s.stopping) {       // stopped while the file was opened, SOUND_CMD_STOP closes it
+            portEXIT_CRITICAL(&mux);             
+            break;
+          }
+          s.chainStart=(s.startMode!=SOUND_START_PLAY);   // no crossfade when the first chunk is ready
+          s.decoding=1;
+          if (s.startMode==SOUND_START_PRELOAD) s.state=SOUND_PRELOADED;
+          else {
+            s.state=SOUND_PLAYING;
+            if ((s.startMode==SOUND_START_CHAIN) && (stream[current].playing) && (current!=c.stream)) 
+              stream[current].chained=c.stream;
+            else {     // the current file has already ended
+              s.queued=0;
+              s.playing=1;
+              current=c.stream;
+            }
+          }
+          portEXIT_CRITICAL(&mux);             
+          xTaskNotifyGive(xReadHandle);   // start reading
+        }
+        if (soundCallback!=NULL) soundCallback((soundHandle_t)(s.serial<<8 | c.stream), s.state);
+        break;
+      case SOUND_CMD_PLAY:
+        playPreloaded(s, c.value);
+        break;
+      case SOUND_CMD_STOP:
+        portENTER_CRITICAL(&mux);             
+        s.refillWait=0;
+        portEXIT_CRITICAL(&mux);             
+        xSemaphoreTake(streamLock, portMAX_DELAY);
+        s.readLen=0;
+        s.file.close();
+        stats.samplesDropped+=s.ring.available();
+        xSemaphoreGive(streamLock);
+        if ((s.decoding) && (verbosity)) Serial.printf("Stream %d stopped\n", c.stream);
+        s.decoding=0;
+        s.stopping=0;
+        break;
+      case SOUND_CMD_SEEK:
+        result=seekStream(s, c.value);
+        break;
+      case SOUND_CMD_RATE:
+        for (uint8_t i=0; i<SOUND_STREAMS; i++) {
+          SoundStream & o = stream[i];
+          if (!o.decoding) continue;     // files which are opened later use the new rate
+          o.resampler.setRate(o.samplingRate, engineRate);
+          // the position continues from the samples which were played at the former rate
+          // (the samples in the sample buffer are played at the new rate)
+          portENTER_CRITICAL(&mux);             
+          uint32_t played=o.sampleCounter;
+          o.sampleCounter=0;
+          if (o.lastSample!=0xffffffff) o.lastSample-=played;
+          portEXIT_CRITICAL(&mux);             
+          o.written-=played;
+          o.startSample+=(uint64_t)played*o.samplingRate/c.value;
+        }
+        break;
     }
+    return(result);
 }
 
+// reads the flags without a lock: if the mixer switched to the next file of the playlist in between
+// (the old stream was stopped, the new one may not be seen yet), the flags are read again
 boolean ESP32Sound_Class::isPlaying(){
+    uint32_t switches;
     uint8_t tmp;
-    portENTER_CRITICAL(&mux);             
-    tmp=playStream;
-    portEXIT_CRITICAL(&mux);
+    do {
+      switches=__atomic_load_n(&streamSwitches, __ATOMIC_ACQUIRE);
+      tmp=0;
+      for (uint8_t i=0; i<SOUND_STREAMS; i++) {
+        tmp|=stream[i].playing;
+        // a file which is still being opened counts as playing (unless it was preloaded)
+        if ((stream[i].queued) && (stream[i].state==SOUND_OPENING) && (stream[i].startMode!=SOUND_START_PRELOAD)) tmp=1;
+      }
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while (switches != __atomic_load_n(&streamSwitches, __ATOMIC_RELAXED));
     if (tmp) return(true);
     return(false); 
 }
 
-uint8_t ESP32Sound_Class::getPeak(){
-  uint8_t actPeak;
+uint32_t ESP32Sound_Class::pushSamples(const int16_t * samples, uint32_t n){
+    if (pullCallback!=NULL) return(0);     // the pull callback is the producer
+    n=pushRing.write(samples, n);
+    if (n) startPush();
+    return(n);
+}
+
+uint32_t ESP32Sound_Class::availableForWrite(){
+    return(pushRing.space());
+}
+
+uint32_t ESP32Sound_Class::getPushFill(){
+    return(pushRing.available());
+}
+
+int16_t * ESP32Sound_Class::getPushBuffer(uint32_t & n){
+    if (pullCallback!=NULL) {              // the pull callback is the producer
+      n=0;
+      return(NULL);
+    }
+    return(pushRing.writePtr(n));
+}
+
+void ESP32Sound_Class::commitPush(uint32_t n){
+    if ((!n) || (pullCallback!=NULL)) return;
+    pushRing.commit(n);
+    startPush();
+}
+
+// new samples were written by the producer. If the buffer ran empty before, the producer was late 
+// when it continues within the time of one buffer (an underrun), a longer pause ends a burst of samples
+void ESP32Sound_Class::startPush(){
+    if ((pushRanEmpty) && (engineRate)) {
+      if ((uint32_t)(millis()-pushEmptyMs) < (uint32_t)pushRing.size()*1000/engineRate) stats.pushUnderruns++;
+      pushRanEmpty=0;
+    }
+    pushStarted=1;
+    startOutput();
+}
+
+void ESP32Sound_Class::setPullCallback(soundPullCallback_t callback){
+    pullCallback=callback;
+    if (xStreamHandle!=NULL) xTaskNotifyGive(xStreamHandle);   // start pulling
+}
+
+void ESP32Sound_Class::setProfiling(boolean enable){
+  profiling=0;
+  memset(&profile, 0, sizeof(profile));
+  profile.outputMinCycles=0xffffffff;
+  profiling=enable;
+}
+
+SoundProfile ESP32Sound_Class::getProfile(){
+  return(profile);
+}
+
+// the counters are 32-bit values with a single writer each, so no lock is needed for reading
+SoundStats ESP32Sound_Class::getStats(){
+  SoundStats st=stats;
+  st.samplesDropped+=fxSamplesStolen;
+  return(st);
+}
+
+void ESP32Sound_Class::resetStats(){
   portENTER_CRITICAL(&mux);             
-  actPeak=peak;
-  portEXIT_CRITICAL(&mux);
-  return(actPeak); 
+  memset(&stats, 0, sizeof(stats));
+  stats.bufferLow=0xffffffff;
+  fxSamplesStolen=0;
+  portEXIT_CRITICAL(&mux);             
+}
+
+uint32_t ESP32Sound_Class::getLeadTimeMs(){
+  SoundStream & s = stream[current];
+  uint32_t frames = s.prefetch.available()/s.unitBytes*s.unitSamples;
+  return((uint64_t)s.ring.available()*1000/engineRate + (uint64_t)frames*1000/s.samplingRate);
+}
+
+void ESP32Sound_Class::setPrefetchSize(uint16_t blockSize, uint8_t blocks){
+  if (isPlaying()) {
+    if (verbosity) Serial.println("Prefetch size cannot be changed while playing!");
+    return;
+  }
+  uint16_t b=SD_SECTOR_SIZE;
+  while ((b < blockSize) && (b < 0x8000)) b<<=1;   // sector-aligned, power of 2
+  if (blocks<2) blocks=2;
+  for (uint8_t i=0; i<SOUND_STREAMS; i++) {
+    if (!stream[i].prefetch.allocate((uint32_t)b*blocks)) {
+      if (verbosity) Serial.println("Could not allocate prefetch buffer!");
+      return;
+    }
+  }
+  prefetchBlock=b;
+}
+
+void ESP32Sound_Class::setRefillWatermarks(uint8_t lowPercent, uint8_t highPercent){
+  if (highPercent > 100) highPercent=100;
+  if (highPercent < 1) highPercent=1;
+  if (lowPercent > highPercent) lowPercent=highPercent;
+  refillLow=lowPercent;
+  refillHigh=highPercent;
+}
+
+uint8_t ESP32Sound_Class::getPeak(){
+  return(peak);    // a single byte, written by the mixer only: no lock needed
 }
 
 void ESP32Sound_Class::stopSound(){
   if (verbosity) Serial.println("Stop sound.");
-  if (xHandle!=NULL) {
-    setPlaying(0);             
-    soundFile.close();
-    vTaskDelete( xHandle );
-    xHandle=NULL;
-    if (verbosity) Serial.println("SoundstreamTask closed.");
-  }
+  portENTER_CRITICAL(&mux);             
+  playlistCount=0;
+  paused=0;
+  portEXIT_CRITICAL(&mux);             
+  for (uint8_t i=0; i<SOUND_STREAMS; i++)
+    if ((stream[i].decoding) || (stream[i].playing) || (stream[i].queued)) stopStream(stream[i]);
 }
 
-void ESP32Sound_Class::playFx(const uint8_t * fxBuf){
+// gets length and format from the header of an FX array, returns 0 if the format is not supported
+uint8_t ESP32Sound_Class::parseFxHeader(const uint8_t * fxBuf, uint32_t & len, uint8_t & fmt){
+    fmt=FX_FORMAT_PCM8;
+    if (fxBuf[3] & FX_FLAG_EXTENDED) {
+      fmt=fxBuf[3] & 0x0f;
+      if ((((fxBuf[3]>>4) & 0x07) != FX_HEADER_VERSION) || (fmt > FX_FORMAT_ADPCM4)) {
+        if (verbosity) Serial.println("FX format not supported!");
+        return(0);
+      }
+    }
+    // the length is stored in the first 4 bytes (low byte first), extended headers use only 3 bytes
+    len= ( ((uint32_t) fxBuf[0]) + ((uint32_t) fxBuf[1]<<8) + ((uint32_t) fxBuf[2]<<16) +
+           ((fxBuf[3] & FX_FLAG_EXTENDED) ? 0 : ((uint32_t) fxBuf[3]<<24)));
+    return(1);
+}
+
+fxHandle_t ESP32Sound_Class::playFx(const uint8_t * fxBuf, uint8_t vol, uint8_t priority){
+    uint32_t len;
+    uint8_t fmt;
+    if (!parseFxHeader(fxBuf, len, fmt)) return(FX_NO_VOICE);
+    return(startFx(fxBuf+4, len, fmt, vol, priority));
+}
+
+// finds a free voice, or a voice to steal according to the steal policy (mux must be taken).
+// returns -1 if all voices are busy with FX of a higher priority (FX_STEAL_PRIORITY)
+int8_t IRAM_ATTR ESP32Sound_Class::findVoice(uint8_t priority){
+    uint8_t i, victim=0;
+
+    for (i=0; i<FX_VOICES; i++) {
+      if (!fxVoice[i].len) return(i);
+      FxVoice & v = fxVoice[i];
+      FxVoice & w = fxVoice[victim];
+      switch (stealPolicy) {
+        case FX_STEAL_QUIETEST: 
+          if (v.volume < w.volume) victim=i;
+          break;
+        case FX_STEAL_PRIORITY: 
+          if ((v.priority < w.priority) || ((v.priority == w.priority) && (v.started < w.started))) victim=i;
+          break;
+        default:
+          if (v.started < w.started) victim=i;
+          break;
+      }
+    }
+    if ((stealPolicy==FX_STEAL_PRIORITY) && (fxVoice[victim].priority > priority)) return(-1);
+    return(victim);
+}
+
+// starts an FX on voice i (mux must be taken). data points to the samples, 
+// for IMA-ADPCM to the decoder state (predictor, step index, 0) which is followed by the samples
+fxHandle_t IRAM_ATTR ESP32Sound_Class::setupVoice(uint8_t i, const uint8_t * data, uint32_t len, uint8_t fmt, uint8_t vol, uint8_t priority){
+    FxVoice & v = fxVoice[i];
+    fxSamplesStolen+=v.len;     // voice stealing
+    v.len=0;
+    v.format=fmt;
+    if (fmt==FX_FORMAT_ADPCM4) {
+      v.predictor=(int16_t)(data[0] | (data[1]<<8));
+      v.index=data[2] > 88 ? 88 : data[2];
+      v.nibble=0;
+      v.loc=data+4;
+    }
+    else v.loc=data;
+    v.volume=vol;
+    v.gain=volumeToGain(vol);
+    v.priority=priority;
+    v.serial=(v.serial+1) & 0x7f;
+    v.started=fxStarts++;
+    v.len=len;
+    return((fxHandle_t)(v.serial<<8 | i));
+}
+
+// the voice is selected and set up in one critical section, so that no other caller 
+// (or startFxEvents() in the mixer) can take the same voice in between
+fxHandle_t ESP32Sound_Class::startFx(const uint8_t * data, uint32_t len, uint8_t fmt, uint8_t vol, uint8_t priority){
     portENTER_CRITICAL(&mux);             
-    playFXLoc=fxBuf+4;
-    // the length is stored in the first 4 bytes (low byte first)
-    playFXLen= ( ((uint32_t) fxBuf[0]) + ((uint32_t) fxBuf[1]<<8) + ((uint32_t) fxBuf[2]<<16) +((uint32_t) fxBuf[3]<<24));
+    int8_t i = findVoice(priority);
+    fxHandle_t handle = (i<0) ? FX_NO_VOICE : setupVoice(i, data, len, fmt, vol, priority);
     portEXIT_CRITICAL(&mux);               
-    timerAlarmEnable(timer); // in case timer is currently not running  
+    if (i<0) {
+      if (verbosity) Serial.println("FX not played: all voices busy.");
+      return(FX_NO_VOICE);
+    }
+    startOutput(); // in case output is currently not running  
+    return(handle);
 }
 
-void ESP32Sound_Class::setPlaybackRate(uint32_t pr){
-    timerAlarmWrite(timer, 1000000/pr, true);
+// called by the mixer: starts all scheduled FX which are due
+void IRAM_ATTR ESP32Sound_Class::startFxEvents(){
+    // the next event is not due yet: no lock (an aligned 32-bit read, the time is checked again under the lock)
+    if ((int32_t)(sampleClock-fxEvents[0].time) < 0) return;
+    portENTER_CRITICAL_ISR(&mux);
+    uint8_t n=0;
+    while ((n<fxEventCount) && ((int32_t)(sampleClock-fxEvents[n].time) >= 0)) {
+      FxEvent & e = fxEvents[n++];
+      int8_t i = findVoice(e.priority);
+      if (i>=0) setupVoice(i, e.data, e.len, e.format, e.volume, e.priority);
+    }
+    if (n) {
+      memmove(fxEvents, fxEvents+n, (fxEventCount-n)*sizeof(FxEvent));
+      fxEventCount-=n;
+    }
+    portEXIT_CRITICAL_ISR(&mux);
 }
 
-void ESP32Sound_Class::setFxVolume(uint8_t vol){
+// inserts an FX into the time-ordered event queue (sample times may wrap around)
+boolean ESP32Sound_Class::scheduleFx(const uint8_t * data, uint32_t len, uint8_t fmt, uint32_t sampleTime, uint8_t vol, uint8_t priority){
     portENTER_CRITICAL(&mux);             
-    fxVolume=vol;
+    uint8_t n=fxEventCount;
+    if (n==FX_EVENTS) {
+      portEXIT_CRITICAL(&mux);             
+      if (verbosity) Serial.println("FX not scheduled: event queue full.");
+      return(false);
+    }
+    while ((n>0) && ((int32_t)(sampleTime-fxEvents[n-1].time) < 0)) {
+      fxEvents[n]=fxEvents[n-1];
+      n--;
+    }
+    FxEvent & e = fxEvents[n];
+    e.time=sampleTime;
+    e.data=data;
+    e.len=len;
+    e.format=fmt;
+    e.volume=vol;
+    e.priority=priority;
+    fxEventCount++;
     portEXIT_CRITICAL(&mux);             
+    startOutput();  // the sample clock only runs while the output is running
+    return(true);
 }
 
-void ESP32Sound_Class::setSoundVolume(uint8_t vol){
-    portENTER_CRITICAL(&mux);             
-    soundVolume=vol;
-    portEXIT_CRITICAL(&mux);             
+boolean ESP32Sound_Class::playFxAt(const uint8_t * fxBuf, uint32_t sampleTime, uint8_t vol, uint8_t priority){
+    uint32_t len;
+    uint8_t fmt;
+    if (!parseFxHeader(fxBuf, len, fmt)) return(false);
+    return(scheduleFx(fxBuf+4, len, fmt, sampleTime, vol, priority));
+}
+
+boolean ESP32Sound_Class::playFxAt(const SoundBank & bank, uint16_t id, uint32_t sampleTime, uint8_t vol, uint8_t priority){
+    const uint8_t * data = bank.data(id);
+    if (data==NULL) {
+      if (verbosity) Serial.printf("FX %d not in bank!\n", id);
+      return(false);
+    }
+    return(scheduleFx(data, bank.samples(id), bank.bits(id)==SOUNDBANK_BITS_ADPCM ? FX_FORMAT_ADPCM4 : FX_FORMAT_PCM8, 
+                      sampleTime, vol, priority));
+}
+
+boolean ESP32Sound_Class::playFxAfter(const uint8_t * fxBuf, uint32_t samples, uint8_t vol, uint8_t priority){
+    return(playFxAt(fxBuf, sampleClock+samples, vol, priority));
+}
+
+boolean ESP32Sound_Class::playFxAfter(const SoundBank & bank, uint16_t id, uint32_t samples, uint8_t vol, uint8_t priority){
+    return(playFxAt(bank, id, sampleClock+samples, vol, priority));
 }
 
-void ESP32Sound_Class::setPlaying(uint8_t p) {
+uint32_t ESP32Sound_Class::getSampleClock(){
+    return(sampleClock);
+}
+
+// lock-free read of the 64-bit sample clock: retried if the mixer updated the upper half meanwhile
+uint64_t ESP32Sound_Class::getSampleClock64(){
+    uint32_t seq, high, low;
+    do {
+      seq=__atomic_load_n(&clockSeq, __ATOMIC_ACQUIRE);
+      high=sampleClockHigh;
+      low=__atomic_load_n(&sampleClock, __ATOMIC_ACQUIRE);
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while ((seq & 1) || (seq != __atomic_load_n(&clockSeq, __ATOMIC_RELAXED)));
+    return(((uint64_t)high<<32) | low);
+}
+
+#ifdef SOUND_HOST
+void ESP32Sound_Class::hostSetSampleClock(uint64_t clock){
+    portENTER_CRITICAL(&mux);
+    __atomic_store_n(&clockSeq, clockSeq+1, __ATOMIC_RELEASE);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    sampleClockHigh=(uint32_t)(clock>>32);
+    __atomic_store_n(&sampleClock, (uint32_t)clock, __ATOMIC_RELEASE);
+    __atomic_store_n(&clockSeq, clockSeq+1, __ATOMIC_RELEASE);
+    portEXIT_CRITICAL(&mux);
+}
+#endif
+
+uint32_t ESP32Sound_Class::getOutputLatencySamples(){
+    // the timer ISR writes each sample to the DAC when it is rendered, the I2S output 
+    // renders a block while the DMA buffers are still queued
+    if (outputMode==SOUND_OUTPUT_I2S) return((uint32_t)I2S_DMA_BUFFERS*blocksize);
+    return(0);
+}
+
+boolean ESP32Sound_Class::loadFxBank(SoundBank & bank, const char * partitionLabel){
+    uint32_t size;
+    const uint8_t * image = soundMapPartition(partitionLabel, size);
+    if (image==NULL) {
+      if (verbosity) Serial.printf("FX bank partition %s not found!\n", partitionLabel);
+      return(false);
+    }
+    if (!bank.attach(image, size)) {
+      if (verbosity) Serial.printf("No valid FX bank in partition %s!\n", partitionLabel);
+      return(false);
+    }
+    if (verbosity) Serial.printf("FX bank %s loaded, %d FX.\n", partitionLabel, bank.count());
+    return(true);
+}
+
+// O(1): the index entries have a fixed size
+fxHandle_t ESP32Sound_Class::playFx(const SoundBank & bank, uint16_t id, uint8_t vol, uint8_t priority){
+    const uint8_t * data = bank.data(id);
+    if (data==NULL) {
+      if (verbosity) Serial.printf("FX %d not in bank!\n", id);
+      return(FX_NO_VOICE);
+    }
+    if ((verbosity) && (bank.rate(id)!=engineRate)) 
+      Serial.printf("FX %d: sampling rate %d differs from playback rate!\n", id, bank.rate(id));
+    return(startFx(data, bank.samples(id), bank.bits(id)==SOUNDBANK_BITS_ADPCM ? FX_FORMAT_ADPCM4 : FX_FORMAT_PCM8, vol, priority));
+}
+
+fxHandle_t ESP32Sound_Class::playFx(const SoundBank & bank, const char * name, uint8_t vol, uint8_t priority){
+    int16_t id = bank.find(name);
+    if (id==SOUNDBANK_NOT_FOUND) {
+      if (verbosity) Serial.printf("FX %s not in bank!\n", name);
+      return(FX_NO_VOICE);
+    }
+    return(playFx(bank, (uint16_t)id, vol, priority));
+}
+
+FxVoice * ESP32Sound_Class::getVoice(fxHandle_t handle){
+    if (handle<0) return(NULL);
+    uint8_t i = handle & 0xff;
+    if ((i>=FX_VOICES) || (fxVoice[i].serial != (handle>>8)) || (!fxVoice[i].len)) return(NULL);
+    return(&fxVoice[i]);
+}
+
+void ESP32Sound_Class::stopFx(fxHandle_t handle){
+    FxVoice * v = getVoice(handle);
+    if (v) v->len=0;
+}
+
+void ESP32Sound_Class::stopAllFx(){
     portENTER_CRITICAL(&mux);             
-    playStream=p;
+    fxEventCount=0;
     portEXIT_CRITICAL(&mux);             
+    for (uint8_t i=0; i<FX_VOICES; i++) fxVoice[i].len=0;
+}
+
+boolean ESP32Sound_Class::isFxPlaying(fxHandle_t handle){
+    return(getVoice(handle) != NULL);
+}
+
+void ESP32Sound_Class::setFxVoiceVolume(fxHandle_t handle, uint8_t vol){
+    FxVoice * v = getVoice(handle);
+    if (v) {
+      v->gain=volumeToGain(vol);
+      v->volume=vol;
+    }
+}
+
+void ESP32Sound_Class::setFxStealPolicy(uint8_t policy){
+    stealPolicy=policy;
+}
+
+void ESP32Sound_Class::setPlaybackRate(uint32_t pr){
+    if (!pr) return;
+    uint32_t former=engineRate;
+    engineRate=pr;
+    if (outputMode==SOUND_OUTPUT_I2S)
+        soundI2SSetRate(pr);
+    else 
+        soundTimerSetRate(pr);
+    postCommand(SOUND_CMD_RATE, 0, former, 1);    // the stream task adjusts the resamplers
+}
+
+void ESP32Sound_Class::setResampleQuality(uint8_t q){
+    resampleQuality=q;
+}
+
+// the gains are calculated here, so that the mixer only needs a multiply and a shift.
+// applied by the stream task when it has applied the queued commands (directly if it is not running yet)
+void ESP32Sound_Class::setFxVolume(uint8_t vol){
+    fxGainRequest=volumeToGain(vol);
+    if (xStreamHandle==NULL) fxGain=fxGainRequest;
+    else xTaskNotifyGive(xStreamHandle);
+}
+
+void ESP32Sound_Class::setSoundVolume(uint8_t vol){
+    soundGainRequest=volumeToGain(vol);
+    if (xStreamHandle==NULL) soundGain=soundGainRequest;
+    else xTaskNotifyGive(xStreamHandle);
 }
 
 void ESP32Sound_Class::setVerbosity(uint8_t v){
@@ -219,6 +1382,7 @@ void ESP32Sound_Class::setVerbosity(uint8_t v){
 
 #define DATA_CHUNK_ID "data"
 #define FMT_CHUNK_ID "fmt "
+#define FACT_CHUNK_ID "fact"
 
 #define GET_LE_LONGWORD(bfr, ofs) (bfr[ofs+3] << 24 | bfr[ofs+2] << 16 |bfr[ofs+1] << 8 |bfr[ofs+0])
 #define GET_LE_SHORTWORD(bfr, ofs) (bfr[ofs+1] << 8 | bfr[ofs+0])
@@ -226,11 +1390,11 @@ void ESP32Sound_Class::setVerbosity(uint8_t v){
 #define WAV_HEADER_BUF 0x30
 
 
-uint8_t ESP32Sound_Class::getWavHeader(){
+uint8_t ESP32Sound_Class::getWavHeader(SoundStream & s){
     uint8_t headerData[WAV_HEADER_BUF];
     uint32_t offset,size, chunkSize;
     
-    if (soundFile.read(headerData,0x0c) != 0x0c) {
+    if (s.file.read(headerData,0x0c) != 0x0c) {
        if (verbosity)  Serial.printf("SD read error: wav header not read\n");
        return(0);
     }
@@ -239,18 +1403,19 @@ uint8_t ESP32Sound_Class::getWavHeader(){
     
     size = GET_LE_LONGWORD(headerData, 4);
     offset=0x0c;
+    s.frames=0xffffffff;
     
     while (offset<size) {
 
-        if (soundFile.read(headerData,8) != 8) {
+        if (s.file.read(headerData,8) != 8) {
            Serial.printf("SD read error: wav header not read\n");
            return(0);
         }
         
         if (!memcmp(headerData, DATA_CHUNK_ID,4)) {
-            dataSize = GET_LE_LONGWORD(headerData, 0x04);
-            dataStart = offset+8;
-            if (verbosity) Serial.printf("Wav file detected, Samplerate=%d, channels=%d, bits=%d, size=%d\n", samplingRate,channels,bits,dataSize);
+            s.dataSize = GET_LE_LONGWORD(headerData, 0x04);
+            s.dataStart = offset+8;
+            if (verbosity) Serial.printf("Wav file detected, Samplerate=%d, s.channels=%d, s.bits=%d, size=%d\n", s.samplingRate,s.channels,s.bits,s.dataSize);
             return(1);
         }
 
@@ -260,15 +1425,20 @@ uint8_t ESP32Sound_Class::getWavHeader(){
                 Serial.printf("SD read error: header chunk size too big!\n");
                 return(0);
             }
-            if (soundFile.read(headerData+8,chunkSize) != chunkSize) {
+            if (s.file.read(headerData+8,chunkSize) != chunkSize) {
                Serial.printf("SD read error: wav header not read\n");
                return(0);
             }
             if (!memcmp(headerData, FMT_CHUNK_ID,4)) {
-                channels = GET_LE_SHORTWORD(headerData,0x0a);
-                samplingRate = GET_LE_LONGWORD(headerData, 0x0c);
-                bits = GET_LE_SHORTWORD(headerData,0x16);
+                s.format = GET_LE_SHORTWORD(headerData,0x08);
+                s.channels = GET_LE_SHORTWORD(headerData,0x0a);
+                s.samplingRate = GET_LE_LONGWORD(headerData, 0x0c);
+                s.blockAlign = GET_LE_SHORTWORD(headerData,0x14);
+                s.bits = GET_LE_SHORTWORD(headerData,0x16);
             }
+            // the number of samples: the last ADPCM block is padded
+            if ((!memcmp(headerData, FACT_CHUNK_ID,4)) && (chunkSize >= 4)) 
+                s.frames = GET_LE_LONGWORD(headerData,0x08);
             offset+=chunkSize+8;
         }        
     }
@@ -277,58 +1447,266 @@ uint8_t ESP32Sound_Class::getWavHeader(){
 
 
 
+// selects the decoder for the current file s.format, returns 0 if the s.format is not supported
+uint8_t ESP32Sound_Class::selectDecoder(SoundStream & s){
+    if (s.format==WAV_FORMAT_IMA_ADPCM) {
+        // blocks must not wrap around in the prefetch buffer: power of 2, not larger than a prefetch block
+        // (the prefetch buffer is reset for each file and each seek, so the first block starts at offset 0)
+        s.unitBytes=s.blockAlign;
+        s.unitSamples=imaAdpcmSamplesPerBlock(s.blockAlign, s.channels);
+        // the resampled samples of a block must fit into the sample buffer
+        return((s.unitSamples) && (s.unitSamples<=MAX_ADPCM_BLOCK_SAMPLES) && (s.channels<=2) &&
+               (!(s.blockAlign & (s.blockAlign-1))) && (s.blockAlign<=prefetchBlock) &&
+               ((uint64_t)s.unitSamples*engineRate/s.samplingRate+2 <= s.ring.size()));
+    }
+    if (s.format!=WAV_FORMAT_PCM) return(0);
+    s.convert=getSoundConverter(s.bits, s.channels);
+    s.unitBytes=(s.bits>>3)*s.channels;
+    s.unitSamples=1;
+    return(s.convert!=NULL);
+}
+
+
+// update the SD read latency histogram (called by the reader task only)
+void ESP32Sound_Class::updateReadStats(uint32_t us){
+  uint32_t ms=us/1000;
+  uint8_t bucket=0;
+  while ((ms) && (bucket < STATS_LATENCY_BUCKETS-1)) {
+    ms>>=1;
+    bucket++;
+  }
+  stats.sdReadLatency[bucket]++;
+  stats.sdReads++;
+  if (us > stats.sdReadMaxUs) stats.sdReadMaxUs=us;
+}
+
+// reads the next block of stream s into its prefetch buffer (called by the reader task with streamLock taken),
+// returns 0 if there is no space in the prefetch buffer
+uint8_t ESP32Sound_Class::readBlock(SoundStream & s){
+    uint32_t toRead, room;
+    int32_t ret;
+
+    // read up to the next block boundary of the file, so that SD reads are sector-aligned
+    toRead = prefetchBlock - (s.readPos % prefetchBlock);
+    if (toRead > s.readLen) toRead=s.readLen;
+    if (s.prefetch.space() < toRead) return(0);
+    uint8_t * dst = s.prefetch.writePtr(room);
+    if (toRead > room) toRead=room;       // wrap-around of the prefetch buffer
+    uint32_t start = soundCycleCount();
+    uint32_t startUs = micros();
+    ret=s.file.read(dst,toRead);
+    updateReadStats(micros()-startUs);
+    if (profiling) {
+      profile.readCycles+=soundCycleCount()-start;
+      profile.readBytes+=ret;
+    }
+    if (ret != (int32_t)toRead) {
+      if (verbosity) Serial.printf("SD read error: %d of %d bytes read\n",ret,toRead);
+      if (ret <= 0) s.readLen=toRead=0;
+      else toRead=ret;
+    }
+    s.prefetch.commit(toRead);
+    s.readPos+=toRead;
+    s.readLen-=toRead;
+    if (!s.readLen) s.readDone=1;
+    if (xStreamHandle!=NULL) xTaskNotifyGive(xStreamHandle);
+    return(1);
+}
+
+// the SD reader task: reads the files ahead of the stream tasks, into their prefetch buffers.
+// The streams are served round robin (one block each), so that they share the SD bandwidth.
+void ESP32Sound_Class::soundReadTask( void * parameter )
+{ 
+    uint8_t next=0;
+
+    while (1) {
+      uint8_t pending=playlistCount, served=0;
+      if (playlistCount) prepareNext();
+      for (uint8_t k=0; (k<SOUND_STREAMS) && (!served); k++) {
+        uint8_t i=(next+k) % SOUND_STREAMS;
+        xSemaphoreTake(streamLock, portMAX_DELAY);
+        if (stream[i].readLen) {
+          pending=1;
+          if (readBlock(stream[i])) {
+            served=1;
+            next=(i+1) % SOUND_STREAMS;
+          }
+        }
+        xSemaphoreGive(streamLock);
+      }
+      // nothing read: wait until a stream task consumed data, or until a new file is started / queued
+      if (!served) ulTaskNotifyTake(pdTRUE, pending ? WAIT_FOR_QUEUESPACE : portMAX_DELAY);
+    }
+}
+
+// the stream task: applies the commands and decodes the prefetched file data of all streams 
+// into their sample buffers, one chunk per stream in turn. Sleeps if there is nothing to do
 void ESP32Sound_Class::soundStreamTask( void * parameter )
 { 
-    uint8_t first=1;
-    uint8_t chunk[chunksize];
-    int32_t ret=0;
-    int32_t len = 0;
-    int32_t toRead = 0;
+    SoundCommand c;
 
     if (verbosity) Serial.println("SoundStreamTask created");    
-    len = dataSize;
-    sampleCounter=0;
-    lastSample=len/(bits>>3)/channels;
-    xQueueReset( xQueue );
-
-    while (len>0) {
-      if (len > chunksize) toRead=chunksize; else toRead=len;
-      if ((ret=soundFile.read(chunk,toRead)) != toRead) {
-            if (verbosity) Serial.printf("SD read error: %d of %d bytes read\n",ret,toRead);
-            toRead=ret; 
-      } 
-      len-=toRead;
-      int sp; 
-      while ((sp=uxQueueSpacesAvailable (xQueue))<toRead) {
-        // if (verbosity) Serial.printf("space in queue: %d/%d .. waiting!\n",sp,toRead);
-        vTaskDelay(WAIT_FOR_QUEUESPACE);
+    while (1) {
+      uint8_t busy=0;
+      while (commands.read(c)) {
+        uint8_t result=applyCommand(c);
+        if (c.result!=NULL) *c.result=result;
+        __atomic_add_fetch(&commandsApplied, 1, __ATOMIC_RELEASE);
+        if (c.waiter!=NULL) xTaskNotifyGive(c.waiter);
       }
-      for (int i=0;i<toRead;i++) {
-        if (bits==8) {
-           xQueueSend(xQueue,( void * ) &(chunk[i]), ( TickType_t ) portMAX_DELAY);
-           if (channels==2) i++;
-        }
-        else if (bits==16) {
-           int16_t val = chunk[i] | ((uint16_t)(chunk[i+1]) << 8);
-           uint8_t act= val/256+128;
-           
-           xQueueSend(xQueue,( void * ) &(act), ( TickType_t ) portMAX_DELAY);
-           i++;
-           if (channels==2) i+=2;           
+      // only the latest volumes are applied (no stale value from a command which was queued before)
+      soundGain=soundGainRequest;
+      fxGain=fxGainRequest;
+      for (uint8_t i=0; i<SOUND_STREAMS; i++) {
+        SoundStream & s = stream[i];
+        if (s.decoding) busy|=decodeChunk(s);
+        else if ((s.file) && (!s.playing) && (!s.queued)) {   // played to the end, see finishStream()
+          xSemaphoreTake(streamLock, portMAX_DELAY);
+          s.file.close();
+          xSemaphoreGive(streamLock);
         }
       }
-      
-      if (first) {
-          timerAlarmEnable(timer);  // in case timer is currently not running  
-          if (verbosity) Serial.println("Timer enabled!\n");
-          first=0;
-      } 
+      uint8_t pulled=1;
+      if (pullCallback!=NULL) busy|=(pulled=pullSamples());
+      // woken by commands, by the reader task (new data) and by the mixer (low watermark).
+      // If the pull callback had no samples, it is polled again after PULL_RETRY_TICKS
+      TickType_t wait = pulled ? portMAX_DELAY : PULL_RETRY_TICKS;
+#if SOUND_REFILL_POLL
+      for (uint8_t i=0; i<SOUND_STREAMS; i++) if ((stream[i].decoding) && (wait > WAIT_FOR_QUEUESPACE)) wait=WAIT_FOR_QUEUESPACE;
+#endif
+      if (!busy) ulTaskNotifyTake(pdTRUE, wait);
+    }
+}
+
+// refills the push buffer from the pull callback (called by the stream task), up to the high watermark.
+// Returns 1 if samples were added, 0 if the callback had none or the buffer is full (then the mixer 
+// wakes the stream task at the low watermark)
+uint8_t ESP32Sound_Class::pullSamples(){
+    uint32_t size=pushRing.size(), fill=pushRing.available();
+    uint32_t high=size*refillHigh/100;
+    if (fill >= high) {
+      uint32_t level=size*refillLow/100;
+      if ((level >= high) && (high)) level=high-1;
+      pushRefillLevel=level;
+      pushRefillWait=1;
+      if (pushRing.available() > level) return(0);
+      pushRefillWait=0;
+      fill=pushRing.available();
+    }
+    uint32_t n;
+    int16_t * buf = pushRing.writePtr(n);
+    if (n > high-fill) n=high-fill;
+    if (!n) return(0);
+    n=pullCallback(buf, n);
+    if (!n) {
+      pushRefillWait=0;
+      return(0);
+    }
+    pushRing.commit(n);
+    startPush();
+    return(1);
+}
+
+// decodes one chunk of stream s (called by the stream task), returns 0 if it has to wait
+// for the reader task or for space in the sample buffer
+uint8_t ESP32Sound_Class::decodeChunk(SoundStream & s){
+    uint32_t avail, used;
+
+    if (s.stopping) return(0);              // wait for SOUND_CMD_STOP (the stream may be reserved again)
+    if (((!s.playing) && (!s.queued)) ||    // stopped by the mixer (faded out)
+        (s.written >= s.writeLimit)) {       // the padding after the last sample (fact chunk) is not played
+      finishStream(s);
+      return(1);
+    }
+    uint8_t done=s.readDone;     // check before reading the fill level (no data can get lost)
+    const uint8_t * src = s.prefetch.readPtr(avail);
+    if (avail < s.unitBytes) {
+      if (done) finishStream(s);
+      return(done);    // otherwise wait for the reader task
+    }
+    uint32_t units = avail/s.unitBytes;
+    uint32_t chunkUnits = s.unitSamples > DEFAULT_CHUNK_SIZE ? 1 : DEFAULT_CHUNK_SIZE/s.unitSamples;
+    if (units > chunkUnits) units=chunkUnits;
+
+    // the output of the chunk (after resampling) must fit into the sample buffer, and the
+    // sample buffer is only refilled up to the high watermark. Otherwise sleep until the 
+    // output drains it below the low watermark (but at least until one unit fits), see notifyRefill()
+    uint32_t size=s.ring.size(), fill=s.ring.available();
+    uint32_t unitOut=(uint64_t)s.unitSamples*engineRate/s.samplingRate+2;
+    uint32_t fit=(size-fill)/unitOut;
+    if (fit < units) units=fit;
+    uint32_t high=size*refillHigh/100;
+    if ((!units) || (fill >= high)) {
+#if SOUND_REFILL_POLL
+      return(0);          // the stream task checks again after WAIT_FOR_QUEUESPACE
+#endif
+      uint32_t level=size*refillLow/100;
+      if (level > size-unitOut) level=size-unitOut;
+      if ((level >= high) && (high)) level=high-1;
+      s.refillLevel=level;
+      s.refillWait=1;
+      if (s.ring.available() > level) return(0);
+      s.refillWait=0;
+      return(1);
+    }
+
+    // decode / convert the data to 16-bit mono samples
+    uint32_t start = soundCycleCount();
+    uint32_t samples;
+    if (s.format==WAV_FORMAT_IMA_ADPCM) 
+      samples=ima_adpcm_to_s16_mono(src, chunkBuffer, units, s.blockAlign, s.channels);
+    else
+      samples=s.convert(src, chunkBuffer, units);
+    s.prefetch.consume(units*s.unitBytes);
+    if (profiling) {
+      profile.streamCycles+=soundCycleCount()-start;
+      profile.streamBytes+=units*s.unitBytes;
+    }
+    if (xReadHandle!=NULL) xTaskNotifyGive(xReadHandle);
+
+    // resample to the playback rate (if necessary) and copy to the sample buffer
+    const int16_t * in=chunkBuffer;
+    while (samples) {
+      const int16_t * out=in;
+      uint32_t n=samples;
+      if (s.resampler.active()) {
+        start = soundCycleCount();
+        n=s.resampler.process(in, samples, used, resampleBuffer, DEFAULT_CHUNK_SIZE);
+        out=resampleBuffer;
+        if (profiling) profile.streamCycles+=soundCycleCount()-start;
+      }
+      else used=samples;
+      in+=used;
+      samples-=used;
+      if (n > s.writeLimit-s.written) n=s.writeLimit-s.written;
+      s.ring.write(out,n);   // one index update for the whole chunk
+      s.written+=n;
+      s.started=1;
+      avail=s.ring.available();
+      if (avail > stats.bufferHigh) stats.bufferHigh=avail;
+    }
+
+    if (s.firstChunk) {
+        if (!s.chainStart) startFade(s);   // crossfade from the other streams (if requested)
+        startOutput();  // in case output is currently not running  
+        if (verbosity) Serial.println("Output enabled!\n");
+        s.firstChunk=0;
     } 
+    return(1);
+}
 
-    if (verbosity) Serial.printf("Finished soundfile after  %u bytes.\n", dataSize);
-    soundFile.close();
-    xHandle=NULL;
-    vTaskDelete( NULL );
-} 
+// called by the stream task when all data of stream s was decoded, or when the stream was stopped by the mixer
+void ESP32Sound_Class::finishStream(SoundStream & s){
+    portENTER_CRITICAL(&mux);
+    s.refillWait=0;
+    portEXIT_CRITICAL(&mux);
+    s.lastSample=s.written;   // in case the file was shorter than announced
+    if (verbosity) Serial.printf("Finished soundfile after  %u samples.\n", s.written);
+    xSemaphoreTake(streamLock, portMAX_DELAY);
+    if ((!s.playing) && (!s.queued)) s.file.close();     // otherwise kept open for seekToSample() until it was played
+    s.readLen=0;
+    xSemaphoreGive(streamLock);
+    s.decoding=0;    // the stream can be reused now
+}
 
 ESP32Sound_Class ESP32Sound;
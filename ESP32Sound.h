@@ -6,64 +6,453 @@
 #ifndef _ESP32Sound_H_
 #define _ESP32Sound_H_
 
-#if defined(ESP32)
+#if defined(ESP32) || defined(SOUND_HOST)   // SOUND_HOST: host build of the tests (see tests/host)
 
 #include <FS.h>
+#include "SoundRing.h"
+#include "SoundConvert.h"
+#include "SoundResampler.h"
+#include "SoundAdpcm.h"
+#include "SoundBank.h"
 
 #define AMP_PIN 25                   // see ODROID-GO schematics
 #define DAC_PIN 26                   // internal DAC2 (pin 26) is used, see ODROID-GO schematics
 #define DEFAULT_SAMPLINGRATE 16000
-#define DEFAULT_SOUNDBUF_SIZE 4096   // default queue size 
-#define DEFAULT_CHUNK_SIZE 512       // samples to read from SD at once 
+#define DEFAULT_SOUNDBUF_SIZE 4096   // default sample buffer size (rounded up to a power of 2)
+#define DEFAULT_CHUNK_SIZE 512       // samples to convert at once 
+#define SD_SECTOR_SIZE 512
+#define DEFAULT_PREFETCH_BLOCK 4096  // bytes to read from SD at once (multiple of SD_SECTOR_SIZE, 4-16KB)
+#define DEFAULT_PREFETCH_BLOCKS 2    // number of prefetch blocks (2: double buffering)
+#define DEFAULT_RESAMPLE_QUALITY RESAMPLE_LINEAR
+#define MAX_ADPCM_BLOCK_SAMPLES 2048 // largest supported IMA-ADPCM block (samples per channel)
 #define DEFAULT_SOUND_VOLUME 30
 #define DEFAULT_FX_VOLUME 50
+#define GAIN_SHIFT 8                 // volume gains are Q8 fixed-point values (256 = 100%)
 #define PEAKDECAY_INTERVAL 50    // samples to wait for peak auto-decrease
-#define WAIT_FOR_QUEUESPACE 10   // ticks to wait if queue has not enough space 
+#define WAIT_FOR_QUEUESPACE 10   // ticks to wait if sample buffer has not enough space 
+#ifndef SOUND_REFILL_POLL
+#define SOUND_REFILL_POLL 0          // 1: a full sample buffer is checked every WAIT_FOR_QUEUESPACE ticks instead of waking
+#endif                               // the stream task at the low watermark (former behaviour, see tests/bench_refill)
+#ifndef SOUND_GAIN_DIVIDE
+#define SOUND_GAIN_DIVIDE 0          // 1: the mixer divides by the volumes in % instead of using Q8 gains (former 
+#endif                               // behaviour, see tests/bench_gain)
+#define DEFAULT_REFILL_LOW  50       // the output wakes the stream task when the sample buffer is below this level (%)
+#define DEFAULT_REFILL_HIGH 100      // the stream task then refills the sample buffer up to this level (%)
+#define STREAM_TASK_STACK 5000       // static stack of the stream task (bytes)
+#define COMMAND_QUEUE_SIZE 16        // commands for the stream task (rounded up to a power of 2)
+#ifndef PUSH_BUFFER_SIZE
+#define PUSH_BUFFER_SIZE 2048        // buffer for samples from pushSamples() / the pull callback (rounded up to a power of 2)
+#endif
+#define PULL_RETRY_TICKS 1           // ticks to wait if the pull callback delivered no samples
+
+#define SOUND_CMD_START        0     // open the file of a stream reserved by startStream() and start decoding it, value: fade time in ms
+#define SOUND_CMD_STOP         1     // stop decoding and close the file
+#define SOUND_CMD_SEEK         2     // continue at sample frame value
+#define SOUND_CMD_PLAY         3     // start a preloaded stream, value: fade time in ms
+#define SOUND_CMD_RATE         4     // the playback rate was changed, value: the former rate
+
+#define SOUND_START_PLAY       0     // start modes of startStream(): play when opened
+#define SOUND_START_CHAIN      1     // started by the mixer when the current stream ends (playlist)
+#define SOUND_START_PRELOAD    2     // opened and buffered, started by play()
+
+typedef int16_t soundHandle_t;       // returned by playSound() / preload(): stream number + serial number
+#define SOUND_NO_HANDLE -1
+#define SOUND_FAILED    0            // file not found or format not supported (or handle not valid)
+#define SOUND_OPENING   1            // the stream task opens the file and parses the header
+#define SOUND_PRELOADED 2            // opened and buffered by preload(), waits for play()
+#define SOUND_PLAYING   3            // playing, or queued in the playlist
+#define SOUND_FINISHED  4            // finished or stopped
+typedef void (*soundCallback_t)(soundHandle_t handle, uint8_t state);
+// fills buf with up to n samples (16-bit mono at the playback rate), returns the number of samples written
+typedef uint32_t (*soundPullCallback_t)(int16_t * buf, uint32_t n);
+
+#ifndef SOUND_STREAMS
+#define SOUND_STREAMS 2              // number of music streams which can be played concurrently (for crossfades)
+#endif
+#define FADE_UNITY 0x40000000        // stream fade gains are Q30 values (0x40000000 = 100%)
+#define PLAYLIST_SIZE 8              // number of files which can be queued with enqueue()
+#define PLAYLIST_PATH_LEN 64         // maximum length of a queued file path (including the terminating 0)
+
+#ifndef FX_VOICES
+#define FX_VOICES 4                  // number of FX which can be played concurrently (4-16)
+#endif
+#define FX_STEAL_OLDEST   0          // voice steal policy if all FX voices are busy: replace the oldest FX
+#define FX_STEAL_QUIETEST 1          // replace the FX with the lowest volume
+#define FX_STEAL_PRIORITY 2          // replace the FX with the lowest priority (only if priority <= new FX)
+#define DEFAULT_STEAL_POLICY FX_STEAL_OLDEST
+#define FX_NO_VOICE -1               // returned by playFx() if no voice could be assigned
+#ifndef FX_EVENTS
+#define FX_EVENTS 16                 // number of FX which can be scheduled with playFxAt() / playFxAfter()
+#endif
+
+// FX header: bytes 0-2: number of samples (low byte first), byte 3: 0 for 8-bit PCM FX
+// or FX_FLAG_EXTENDED | (header version << 4) | sample format (see wav2array.py)
+#define FX_FLAG_EXTENDED  0x80
+#define FX_HEADER_VERSION 1
+#define FX_FORMAT_PCM8    0          // 8-bit unsigned samples
+#define FX_FORMAT_ADPCM4  1          // IMA-ADPCM: start predictor (2 bytes), step index, 0, 2 samples per byte
+
+#define DITHER_NONE       0          // quantization of the 16-bit mix bus to the 8-bit DAC: rounding only
+#define DITHER_TPDF       1          // triangular dither: no distortion of quiet signals, constant noise floor
+#define DITHER_NOISESHAPE 2          // triangular dither with first-order noise shaping (less audible noise)
+#ifndef SOUND_DITHER
+#define SOUND_DITHER DITHER_TPDF
+#endif
+
+#define SOUND_ANY_CORE -1            // pipeline stage without core affinity, see setPipeline()
+#define DEFAULT_IO_CORE 0            // SD reader and stream tasks (the Arduino loop() runs on core 1)
+#define DEFAULT_OUTPUT_CORE 1        // timer interrupt or I2S output task
+#define DEFAULT_READER_PRIORITY 1
+#define DEFAULT_DECODER_PRIORITY 1
+#define DEFAULT_OUTPUT_PRIORITY 2
+
+#define SOUND_OUTPUT_TIMER 0         // output mode: timer ISR writes every sample to the DAC
+#define SOUND_OUTPUT_I2S   1         // output mode: blocks of samples are sent to the DAC via I2S / DMA
+#define DEFAULT_OUTPUT_MODE SOUND_OUTPUT_TIMER
+#define DEFAULT_BLOCK_SIZE 128       // samples per block in I2S output mode (64-256)
+#define MAX_BLOCK_SIZE 256
+#define I2S_DMA_BUFFERS 4            // number of DMA buffers (of one block each)
+
+#define PROFILE_BUCKETS 64           // histogram of output cycles: PROFILE_BUCKETS buckets ...
+#define PROFILE_BUCKET_CYCLES 32     // ... of PROFILE_BUCKET_CYCLES cycles, the last bucket counts all longer calls
+
+// core affinity and task priorities of the pipeline stages, see setPipeline().
+// The stages are connected by lock-free ring buffers (prefetch and sample buffer of each stream)
+struct SoundPipeline {
+    int8_t  ioCore;               // core of the SD reader task and the stream tasks (decoding), or SOUND_ANY_CORE
+    int8_t  outputCore;           // core of the mixer: timer interrupt or I2S output task, or SOUND_ANY_CORE
+    uint8_t readerPriority;       // FreeRTOS priorities of the tasks (the Arduino loop() has priority 1)
+    uint8_t decoderPriority;
+    uint8_t outputPriority;       // I2S output task
+};
+
+// profiling data, see setProfiling() and examples/benchmark
+struct SoundProfile {
+    uint32_t outputCalls;         // timer interrupts (timer mode) or rendered blocks (I2S mode)
+    uint32_t outputMinCycles;
+    uint32_t outputMaxCycles;
+    uint64_t outputTotalCycles;
+    uint32_t outputHistogram[PROFILE_BUCKETS];
+    uint32_t streamBytes;         // file bytes decoded by the stream task
+    uint32_t streamCycles;        // cycles for decoding and resampling these bytes
+    uint32_t readBytes;           // file bytes read from SD by the reader task
+    uint32_t readCycles;          // cycles spent in SD reads
+};
+
+#define STATS_LATENCY_BUCKETS 8      // SD read latency histogram: bucket 0 counts reads < 1ms, bucket i reads < 2^i ms
+
+// audio health counters, see getStats() (always enabled, each counter has a single writer)
+struct SoundStats {
+    uint32_t underruns;           // music samples which were not ready when the output needed them
+    uint32_t bufferLow;           // lowest / highest fill level of the sample buffer while streaming (samples)
+    uint32_t bufferHigh;
+    uint32_t sdReads;             // number of SD reads by the reader task
+    uint32_t sdReadLatency[STATS_LATENCY_BUCKETS];
+    uint32_t sdReadMaxUs;         // slowest SD read in microseconds
+    uint32_t outputMaxCycles;     // worst-case duration of the timer ISR (timer mode) or of a block (I2S mode)
+    uint32_t samplesRendered;     // output samples mixed since begin() or resetStats()
+    uint32_t samplesDropped;      // buffered music discarded by stopSound() or a seek (stream task) and FX samples
+                                  // cut off by voice stealing (counted separately, added by getStats())
+    uint32_t startLatencyUs;      // time from the last playSound() call to its first output sample
+    uint32_t refillWakeups;       // stream task wake-ups by the output (sample buffer below the low watermark, end of a file)
+    uint32_t pushUnderruns;       // the buffer of pushSamples() / the pull callback ran empty while the producer was active
+};
+
+// a command for the stream task, applied between two decoded chunks
+struct SoundCommand {
+    uint8_t           type;         // SOUND_CMD_xxx
+    uint8_t           stream;
+    uint32_t          value;
+    TaskHandle_t      waiter;       // notified when the command was applied, or NULL
+    uint8_t *         result;       // the result is stored here before the waiter is notified (or NULL)
+};
+
+// state of one music stream: file, buffers, decoder and fade gain
+struct SoundStream {
+    SoundRing<int16_t> ring;        // decoded 16-bit samples: soundStreamTask -> output
+    SoundRing<uint8_t> prefetch;    // raw file data: soundReadTask -> soundStreamTask
+    File              file;
+    fs::FS *          fs;           // the file is opened by the stream task
+    char              path[PLAYLIST_PATH_LEN];
+    volatile uint8_t  state;        // SOUND_OPENING ... SOUND_FINISHED, see getSoundState()
+    uint8_t           startMode;    // SOUND_START_PLAY, SOUND_START_CHAIN or SOUND_START_PRELOAD
+    uint8_t           serial;       // incremented on each start, invalidates old handles
+    volatile uint8_t  decoding;     // set by the stream task while it decodes this stream
+    volatile uint8_t  stopping;     // SOUND_CMD_STOP was posted and not applied yet (the stream may be reserved again)
+    uint8_t           firstChunk;   // stream task state: the first chunk starts the output (and the crossfade)
+    uint8_t           chainStart;   // started by the mixer after the current file, no fade
+    uint32_t          written;      // samples written to the sample buffer
+    uint32_t          writeLimit;   // samples of the file after startSample at the playback rate (fact chunk), see decodeChunk()
+    volatile uint8_t  playing;
+    volatile uint8_t  queued;       // decoded ahead, started by the mixer when the stream before it ends
+    volatile int8_t   chained;      // stream which is started when this one ends, -1 if none
+    volatile uint8_t  started;      // set when the first samples are in the sample buffer
+    volatile uint8_t  readDone;
+    volatile uint8_t  awaitFirstSample;  // cleared with the first output sample
+    volatile uint8_t  refillWait;   // the stream task sleeps until the fill level drops to refillLevel
+    volatile uint32_t refillLevel;
+    volatile uint32_t sampleCounter;
+    volatile uint32_t lastSample;
+    uint32_t          startSample;  // file position (in frames) of the first decoded sample, see seekToSample()
+    uint32_t          frames;       // sample frames of the file (fact chunk), 0xffffffff if unknown
+    volatile uint32_t fade;         // Q30 fade gain
+    volatile int32_t  fadeStep;     // added to the fade gain with every output sample
+    volatile uint32_t fadeLeft;     // output samples until the fade ends (then the gain is set to its target)
+    uint32_t          fadeSamples;  // length of the crossfade, started when the first samples are ready
+    uint32_t          startNo;      // start number, used to find the oldest stream
+    uint32_t          readPos;      // file position and remaining bytes for the reader task
+    uint32_t          readLen;
+    uint32_t          playStartUs;
+    uint16_t          channels;
+    uint16_t          bits;
+    uint16_t          format;       // WAV_FORMAT_PCM or WAV_FORMAT_IMA_ADPCM
+    uint16_t          blockAlign;
+    soundConvertFunc  convert;      // conversion kernel for the file format
+    uint16_t          unitBytes;    // decoder input unit: one frame (PCM) or one block (ADPCM)
+    uint16_t          unitSamples;  // samples per decoder unit
+    uint32_t          samplingRate; // sampling rate of the file
+    uint32_t          dataStart;
+    uint32_t          dataSize;
+    SoundResampler    resampler;
+};
+
+// a file in the playlist, see enqueue()
+struct PlaylistEntry {
+    fs::FS *          fs;
+    char              path[PLAYLIST_PATH_LEN];
+};
+
+typedef int16_t fxHandle_t;   // voice handle returned by playFx(): voice number + serial number
+
+struct FxVoice {
+    const uint8_t *   loc;        // current sample position
+    volatile uint32_t len;        // remaining samples, 0 if voice is free
+    volatile uint8_t  volume;     // in %, 0-255
+    volatile uint16_t gain;       // volume as Q8 gain
+    uint8_t           priority;
+    uint8_t           format;     // FX_FORMAT_PCM8 or FX_FORMAT_ADPCM4
+    uint8_t           nibble;     // ADPCM: 1 if the high nibble of *loc is next
+    int16_t           predictor;  // ADPCM decoder state
+    int8_t            index;
+    uint8_t           serial;     // incremented on each start, invalidates old handles
+    uint32_t          started;    // start number, used to find the oldest voice
+};
+
+// an FX scheduled with playFxAt(), started by the mixer at the given sample
+struct FxEvent {
+    uint32_t          time;       // sample clock value of the first FX sample
+    const uint8_t *   data;
+    uint32_t          len;
+    uint8_t           format;
+    uint8_t           volume;
+    uint8_t           priority;
+};
 
 class ESP32Sound_Class {
 
  private: 
-    static hw_timer_t * timer;
-    static QueueHandle_t xQueue;
+    static SoundStream stream[SOUND_STREAMS];
+    static uint8_t current;             // the most recently started stream
+    static uint8_t streamActive;        // number of streams active in the last rendered sample
     static portMUX_TYPE mux;
-    static TaskHandle_t xHandle;
+    static SemaphoreHandle_t streamLock;   // protects the files and the reader state of the streams
+    static TaskHandle_t xReadHandle;
+    static uint16_t prefetchBlock;
+    static TaskHandle_t xOutputHandle;
     static void soundTimer();   // the timer ISR
-    static uint8_t getWavHeader();
-    static void setPlaying(uint8_t p);
+    static uint8_t renderSample();
+    static void startOutput();
+    static uint8_t getWavHeader(SoundStream & s);
+    static uint8_t selectDecoder(SoundStream & s);
+    static int8_t findFreeStream();
+    static soundHandle_t startStream(fs::FS &fs, const char * path, uint32_t fadeMs, uint8_t mode=SOUND_START_PLAY);
+    static uint8_t openStream(SoundStream & s);
+    static void playPreloaded(SoundStream & s, uint16_t fadeMs);
+    static SoundStream * getStream(soundHandle_t handle);
+    static soundCallback_t soundCallback;
+    static void prepareNext();
+    static volatile uint8_t paused;
+    static PlaylistEntry playlist[PLAYLIST_SIZE];
+    static uint8_t playlistHead;
+    static volatile uint8_t playlistCount;
+    static uint8_t loopPlaylist;
+    static void startFade(SoundStream & s);
+    static void stopStream(SoundStream & s, uint8_t wait=1);
+    static uint8_t readBlock(SoundStream & s);
+    static SoundPipeline pipeline;
+    static BaseType_t taskCore(int8_t core) { return(core < 0 ? tskNO_AFFINITY : core); }
+    static void timerSetupTask(void * parameter);
+    static volatile uint8_t refillRequest;   // set by the mixer: the stream task must be woken
+    static uint8_t refillLow;
+    static uint8_t refillHigh;
+    static void notifyRefill(uint8_t fromIsr);
+
+    // samples of the application (emulators, synthesizers), mixed like a music stream
+    static SoundRing<int16_t> pushRing;     // producer: pushSamples() or the stream task (pull callback)
+    static volatile uint8_t pushStarted;    // set by the producer, cleared by the mixer when the buffer ran empty
+    static volatile uint8_t pushRanEmpty;   // the buffer of pushSamples() ran empty at pushEmptyMs (see startPush())
+    static volatile uint32_t pushEmptyMs;
+    static volatile uint8_t pushRefillWait; // the stream task waits until the buffer is below the low watermark
+    static uint32_t pushRefillLevel;
+    static soundPullCallback_t pullCallback;
+    static uint8_t pullSamples();
+    static void startPush();
+
+    // the stream task is created once in begin() and decodes all streams, it gets its work via the command ring
+    static TaskHandle_t xStreamHandle;
+    static StaticTask_t streamTaskBuffer;
+    static StackType_t streamTaskStack[STREAM_TASK_STACK];
+    static int16_t chunkBuffer[MAX_ADPCM_BLOCK_SAMPLES];
+    static int16_t resampleBuffer[DEFAULT_CHUNK_SIZE];
+    static SoundRing<SoundCommand> commands;
+    static SemaphoreHandle_t commandLock;  // serializes the producers (the stream task reads without a lock)
+    static uint32_t commandsPosted;
+    static volatile uint32_t commandsApplied;
+    static uint8_t postCommand(uint8_t type, uint8_t stream, uint32_t value, uint8_t wait);
+    static uint8_t applyCommand(const SoundCommand & c);
+    static uint8_t decodeChunk(SoundStream & s);
+    static void finishStream(SoundStream & s);
+    static uint8_t seekStream(SoundStream & s, uint32_t n);
 
-    static File soundFile;
-    static uint8_t * buf;
     static uint16_t bufsize;
-    static uint16_t chunksize;
-    static volatile uint32_t sampleCounter;
-    static volatile uint32_t lastSample;
-    static const uint8_t *   playFXLoc;
-    static volatile uint32_t playFXLen;
-    static volatile uint8_t playStream;
-    static volatile uint8_t fxVolume;
-    static volatile uint8_t soundVolume;
-    static uint8_t  peak;
+    static uint8_t  outputMode;
+    static uint16_t blocksize;
+    static FxVoice fxVoice[FX_VOICES];
+    static uint8_t fxActive;      // number of voices active in the last rendered sample
+    static volatile uint8_t profiling;
+    static SoundProfile profile;
+    static void profileOutput(uint32_t cycles);
+    static SoundStats stats;
+    static uint32_t fxSamplesStolen;   // FX samples cut off by voice stealing (written under mux), see getStats()
+    static void updateReadStats(uint32_t us);
+    static uint8_t stealPolicy;
+    static uint32_t fxStarts;
+    static uint32_t streamStarts;
+    static FxVoice * getVoice(fxHandle_t handle);
+    static fxHandle_t startFx(const uint8_t * data, uint32_t len, uint8_t fmt, uint8_t vol, uint8_t priority);
+    static int8_t findVoice(uint8_t priority);
+    static fxHandle_t setupVoice(uint8_t i, const uint8_t * data, uint32_t len, uint8_t fmt, uint8_t vol, uint8_t priority);
+    static uint8_t parseFxHeader(const uint8_t * fxBuf, uint32_t & len, uint8_t & fmt);
+    static boolean scheduleFx(const uint8_t * data, uint32_t len, uint8_t fmt, uint32_t sampleTime, uint8_t vol, uint8_t priority);
+    static void startFxEvents();
+    static FxEvent fxEvents[FX_EVENTS];     // sorted by time, fxEvents[0] is the next one
+    static volatile uint8_t fxEventCount;
+    static volatile uint32_t sampleClock;   // number of output samples rendered since begin() (lower 32 bits)
+    static volatile uint32_t sampleClockHigh;  // upper 32 bits, written inside the clock seqlock
+    static volatile uint32_t clockSeq;      // seqlock of the 64-bit clock: odd while the mixer updates it
+    static volatile uint32_t streamSwitches;   // incremented by the mixer after it switched to a chained stream
+    static volatile uint16_t fxGain;      // Q8 gains, recalculated when the volume is set
+    static volatile uint16_t soundGain;
+    static volatile uint16_t fxGainRequest;    // the latest gains set, applied by the stream task
+    static volatile uint16_t soundGainRequest;
+#if SOUND_GAIN_DIVIDE
+    static uint16_t volumeToGain(uint8_t vol) { return(vol); }
+#else
+    static uint16_t volumeToGain(uint8_t vol) { return((((uint16_t)vol<<GAIN_SHIFT)+50)/100); }
+#endif
+    static volatile uint8_t peak;
     static uint8_t  verbosity;
-    static uint16_t channels;
-    static uint16_t bits;
-    static uint32_t samplingRate;
-    static uint32_t dataStart;
-    static uint32_t dataSize;
+    static uint32_t engineRate;         // playback rate given in begin(), music is resampled to this rate
+    static uint8_t resampleQuality;
  
   public: 
     // initialize system, set playback rate and buffer size
-    static void begin(uint32_t samplingrate=DEFAULT_SAMPLINGRATE, uint16_t soundbufSize=DEFAULT_SOUNDBUF_SIZE);
-    static void playSound(fs::FS &fs, const char * path);  // start music playback from file
-    static boolean isPlaying();                  // true if music is playing, false otherwise 
-    static void stopSound();                     // stops playback
-    static void playFx(const uint8_t * fxBuf);   // plays small effects from flash memory
-    static void setPlaybackRate(uint32_t pr);    // sets playback rate in samples/sec
+    static void begin(uint32_t samplingrate=DEFAULT_SAMPLINGRATE, uint16_t soundbufSize=DEFAULT_SOUNDBUF_SIZE,
+                      uint8_t outputmode=DEFAULT_OUTPUT_MODE, uint16_t blockSize=DEFAULT_BLOCK_SIZE);
+    // sets core affinity and priorities of the audio tasks (call before begin(), stream tasks use it when created)
+    static void setPipeline(const SoundPipeline & p);
+    static SoundPipeline getPipeline();
+    // starts music playback from file (the path can have up to PLAYLIST_PATH_LEN-1 characters). 
+    // Returns at once, the file is opened by the stream task. Returns a handle, or SOUND_NO_HANDLE
+    static soundHandle_t playSound(fs::FS &fs, const char * path);
+    // crossfades from the current music to another file within ms milliseconds
+    static soundHandle_t crossfadeTo(fs::FS &fs, const char * path, uint16_t ms);
+    // opens a file and fills its buffers without playing it, play() starts it without delay
+    static soundHandle_t preload(fs::FS &fs, const char * path);
+    // starts a preloaded file (stops the current music, or crossfades to the file within fadeMs milliseconds)
+    static boolean play(soundHandle_t handle, uint16_t fadeMs=0);
+    static uint8_t getSoundState(soundHandle_t handle);   // SOUND_OPENING, SOUND_PLAYING, ... SOUND_FAILED
+    // the callback is called by the stream task when a file was opened (state SOUND_PLAYING or SOUND_PRELOADED)
+    // or could not be played (SOUND_FAILED), it must return quickly. It may call stopSound(), seekToSample(),
+    // setPlaybackRate() etc.: these are applied at once (before the commands which are still queued)
+    static void setSoundCallback(soundCallback_t callback);
+    static boolean isPlaying();                  // true if music is playing (or being opened), false otherwise 
+    static void stopSound();                     // stops playback and clears the playlist
+    // appends a file to the playlist (it is started when the current file ends, without a gap)
+    static boolean enqueue(fs::FS &fs, const char * path);
+    static void setLoop(boolean loop);           // true: started files are appended to the playlist again
+    static void next();                          // skips to the next file of the playlist
+    static void pause();                         // pauses the music (the buffers are kept, FX continue)
+    static void resume();                        // resumes paused music without delay
+    static boolean isPaused();
+    // continues the music at the given sample frame of the file (block start for IMA-ADPCM), false if not possible
+    static boolean seekToSample(uint32_t n);
+    static uint32_t getPositionSamples();        // sample frame of the file which is played now
+    // plays small effects from flash memory, returns a voice handle (or FX_NO_VOICE)
+    static fxHandle_t playFx(const uint8_t * fxBuf, uint8_t vol=100, uint8_t priority=0);
+    // maps the FX bank stored in the given data partition, returns false if it was not found or is not valid
+    static boolean loadFxBank(SoundBank & bank, const char * partitionLabel);
+    // plays an effect of a bank (by id or by name), the samples are read in place from flash
+    static fxHandle_t playFx(const SoundBank & bank, uint16_t id, uint8_t vol=100, uint8_t priority=0);
+    static fxHandle_t playFx(const SoundBank & bank, const char * name, uint8_t vol=100, uint8_t priority=0);
+    static void stopFx(fxHandle_t handle);       // stops an effect
+    // starts an effect exactly at the given sample clock value (see getSampleClock()), or after the given
+    // number of samples. Returns false if the event queue is full. FX which are due already start immediately
+    static boolean playFxAt(const uint8_t * fxBuf, uint32_t sampleTime, uint8_t vol=100, uint8_t priority=0);
+    static boolean playFxAt(const SoundBank & bank, uint16_t id, uint32_t sampleTime, uint8_t vol=100, uint8_t priority=0);
+    static boolean playFxAfter(const uint8_t * fxBuf, uint32_t samples, uint8_t vol=100, uint8_t priority=0);
+    static boolean playFxAfter(const SoundBank & bank, uint16_t id, uint32_t samples, uint8_t vol=100, uint8_t priority=0);
+    // output samples rendered since begin(): runs while sound is output, also while paused (FX continue)
+    static uint32_t getSampleClock();
+    static uint64_t getSampleClock64();          // the same as a monotonic 64-bit value, can be read without locks
+    // samples between the mixer and the DAC (DMA buffers in I2S mode): the sample which is heard now
+    // was rendered at getSampleClock64() - getOutputLatencySamples()
+    static uint32_t getOutputLatencySamples();
+    static void stopAllFx();                     // stops all effects (also the scheduled ones)
+    static boolean isFxPlaying(fxHandle_t handle);  // true if the effect is still playing
+    static void setFxVoiceVolume(fxHandle_t handle, uint8_t vol);  // sets volume of a single effect (in %)
+    static void setFxStealPolicy(uint8_t policy);   // FX_STEAL_OLDEST, FX_STEAL_QUIETEST or FX_STEAL_PRIORITY
+    // sets playback rate in samples/sec: music keeps its pitch (it is resampled to the new rate), 
+    // FX and pushed samples are played faster / slower
+    static void setPlaybackRate(uint32_t pr);
+    static void setResampleQuality(uint8_t q);   // RESAMPLE_LINEAR or RESAMPLE_FIR (for following playSound calls)
     static void setFxVolume(uint8_t vol);        // sets effects volume (in %, 0-255, 100 is original)
     static void setSoundVolume(uint8_t vol);     // sets music volume (in %, 0-255, 100 is original)
     static void setVerbosity(uint8_t verbosity); // 0: quite, 1:chatty
     static uint8_t getPeak();                    // gets the current peak volume (0-127)
+    static uint32_t getLeadTimeMs();             // buffered music (prefetched + decoded) in milliseconds
+    // sets size of SD reads and number of prefetch buffers (call before playSound)
+    static void setPrefetchSize(uint16_t blockSize, uint8_t blocks=DEFAULT_PREFETCH_BLOCKS);
+    // sets the fill levels (in % of the sample buffer) at which the stream tasks are woken and stop refilling
+    static void setRefillWatermarks(uint8_t lowPercent, uint8_t highPercent=DEFAULT_REFILL_HIGH);
+
+    // plays samples generated by the application (16-bit mono at the playback rate), mixed with music and FX.
+    // Does not block: returns the number of samples which fit into the buffer
+    static uint32_t pushSamples(const int16_t * samples, uint32_t n);
+    static uint32_t availableForWrite();         // free space for pushSamples() (in samples)
+    static uint32_t getPushFill();               // pushed samples which are not played yet
+    // zero-copy access: gets the contiguous free space of the buffer (n is set to its size), 
+    // write the samples there and call commitPush()
+    static int16_t * getPushBuffer(uint32_t & n);
+    static void commitPush(uint32_t n);
+    // alternatively, the stream task calls the callback to refill the buffer (NULL: use pushSamples()),
+    // the same functions as in the sound callback may be called from it
+    static void setPullCallback(soundPullCallback_t callback);
+
+    static void setProfiling(boolean enable);    // resets the profiling data and enables/disables profiling
+    static SoundProfile getProfile();            // gets the profiling data
+    static SoundStats getStats();                // gets the audio health counters (underruns, buffer levels, ...)
+    static void resetStats();                    // resets the audio health counters
+
+    // renders n output samples (8-bit DAC values) into out, returns false if nothing is playing
+    static bool renderBlock(uint8_t * out, uint16_t n);
+#ifdef SOUND_HOST
+    static void hostSetSampleClock(uint64_t clock);   // host tests only: presets the sample clock (wrap-around)
+#endif
 
     static void soundStreamTask( void * parameter );
+    static void soundReadTask( void * parameter );
+    static void soundOutputTask( void * parameter );
 };
 
 extern ESP32Sound_Class ESP32Sound;
@@ -0,0 +1,47 @@
+//
+//  SoundAdpcm - IMA-ADPCM decoder
+//  part of the ESP32Sound library, https://github.com/ChrisVeigl/ESP32Sound
+//
+//  This code is released under GPLv3 license.
+//  see: https://www.gnu.org/licenses/gpl-3.0.en.html and https://www.fsf.org/
+
+#include "SoundAdpcm.h"
+
+const int16_t imaStepTable[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230, 
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963, 
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327, 
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 
+    12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+const int8_t imaIndexTable[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+uint32_t imaAdpcmSamplesPerBlock(uint16_t blockAlign, uint16_t channels) {
+    if (blockAlign <= 4*channels) return(0);
+    return((uint32_t)(blockAlign - 4*channels) * 2 / channels + 1);
+}
+
+uint32_t ima_adpcm_to_s16_mono(const uint8_t * in, int16_t * out, uint32_t n, uint16_t blockAlign, uint16_t channels) {
+    uint32_t count=0;
+    uint16_t groupStep = 4*channels;     // distance between 4-byte groups of the left channel
+
+    for (uint32_t b=0; b<n; b++, in+=blockAlign) {
+        int16_t predictor = (int16_t)(in[0] | (in[1] << 8));
+        int8_t  index = in[2] > 88 ? 88 : in[2];
+        out[count++] = predictor;
+
+        for (uint32_t ofs = 4*channels; ofs + 4 <= blockAlign; ofs += groupStep) {
+            for (uint8_t i=0; i<4; i++) {
+                uint8_t v = in[ofs+i];
+                out[count++] = imaAdpcmDecode(v & 0x0f, predictor, index);
+                out[count++] = imaAdpcmDecode(v >> 4, predictor, index);
+            }
+        }
+    }
+    return(count);
+}
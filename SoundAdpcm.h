@@ -0,0 +1,49 @@
+//
+//  SoundAdpcm - IMA-ADPCM decoder
+//  part of the ESP32Sound library, https://github.com/ChrisVeigl/ESP32Sound
+//
+//  Decodes IMA-ADPCM .wav data (format tag 0x11, 4 bits per sample) block by block 
+//  into 16-bit signed mono samples. Each block starts with a header per channel 
+//  (16-bit predictor, step index, reserved byte), followed by 4-byte groups of 8 nibbles 
+//  per channel. For stereo files only the left channel is decoded.
+//  The single-step decoder imaAdpcmDecode() is also used for compressed FX.
+//  This file is plain C++ (no Arduino / FreeRTOS dependencies).
+//
+//  This code is released under GPLv3 license.
+//  see: https://www.gnu.org/licenses/gpl-3.0.en.html and https://www.fsf.org/
+
+#ifndef _SoundAdpcm_H_
+#define _SoundAdpcm_H_
+
+#include <stdint.h>
+
+#define WAV_FORMAT_PCM       0x0001
+#define WAV_FORMAT_IMA_ADPCM 0x0011
+
+extern const int16_t imaStepTable[89];
+extern const int8_t  imaIndexTable[16];
+
+// decodes one nibble, updates predictor and step index
+static inline int16_t imaAdpcmDecode(uint8_t nibble, int16_t & predictor, int8_t & index) {
+    int32_t step = imaStepTable[index];
+    int32_t diff = step >> 3;
+    if (nibble & 1) diff += step >> 2;
+    if (nibble & 2) diff += step >> 1;
+    if (nibble & 4) diff += step;
+    int32_t p = predictor + ((nibble & 8) ? -diff : diff);
+    if (p > 32767) p = 32767;
+    if (p < -32768) p = -32768;
+    predictor = (int16_t)p;
+    index += imaIndexTable[nibble];
+    if (index < 0) index = 0;
+    if (index > 88) index = 88;
+    return (predictor);
+}
+
+// number of samples (per channel) in a block of blockAlign bytes
+uint32_t imaAdpcmSamplesPerBlock(uint16_t blockAlign, uint16_t channels);
+
+// decodes n blocks of blockAlign bytes, returns the number of samples written to out
+uint32_t ima_adpcm_to_s16_mono(const uint8_t * in, int16_t * out, uint32_t n, uint16_t blockAlign, uint16_t channels);
+
+#endif
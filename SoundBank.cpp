@@ -0,0 +1,95 @@
+//
+//  SoundBank - index of FX stored in a binary bank image
+//  part of the ESP32Sound library, https://github.com/ChrisVeigl/ESP32Sound
+//
+//  The image is validated once in attach(), so the accessors only check the id.
+//  The index is read byte by byte (no alignment requirements).
+//
+//  This code is released under GPLv3 license.
+//  see: https://www.gnu.org/licenses/gpl-3.0.en.html and https://www.fsf.org/
+
+#include <string.h>
+#include "SoundBank.h"
+
+#if !defined(ESP32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+static inline uint16_t get16(const uint8_t * p) { return (p[0] | (p[1]<<8)); }
+static inline uint32_t get32(const uint8_t * p) { return (p[0] | (p[1]<<8) | (p[2]<<16) | ((uint32_t)p[3]<<24)); }
+
+bool SoundBank::attach(const uint8_t * data, uint32_t size) {
+    image=NULL;
+    entries=0;
+    if ((data == NULL) || (size < SOUNDBANK_HEADER_SIZE) || memcmp(data, SOUNDBANK_MAGIC, 4) ||
+        (get16(data+4) != SOUNDBANK_VERSION))
+        return (false);
+    uint16_t n = get16(data+6);
+    if (SOUNDBANK_HEADER_SIZE + (uint32_t)n*SOUNDBANK_ENTRY_SIZE > size) return (false);
+
+    for (uint16_t i=0; i<n; i++) {
+        const uint8_t * e = data + SOUNDBANK_HEADER_SIZE + (uint32_t)i*SOUNDBANK_ENTRY_SIZE;
+        uint32_t offset = get32(e+SOUNDBANK_NAME_LEN), sampleCount = get32(e+SOUNDBANK_NAME_LEN+4), len;
+        uint8_t b = e[SOUNDBANK_NAME_LEN+10];
+        if (b == SOUNDBANK_BITS_PCM) len = sampleCount;
+        else if (b == SOUNDBANK_BITS_ADPCM) len = 4 + sampleCount/2 + (sampleCount&1);
+        else return (false);
+        if ((e[SOUNDBANK_NAME_LEN-1] != 0) || (offset & 3) || (offset > size) || (len > size-offset))
+            return (false);
+    }
+    image=data;
+    imageSize=size;
+    entries=n;
+    return (true);
+}
+
+#if !defined(ESP32)
+bool SoundBank::mapFile(const char * path) {
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return (false);
+    if (fstat(fd, &st) || (st.st_size <= 0)) {
+        close(fd);
+        return (false);
+    }
+    void * p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);     // the mapping stays valid
+    if (p == MAP_FAILED) return (false);
+    if (!attach((const uint8_t *) p, st.st_size)) {
+        munmap(p, st.st_size);
+        return (false);
+    }
+    return (true);
+}
+#endif
+
+int16_t SoundBank::find(const char * name) const {
+    for (uint16_t i=0; i<entries; i++)
+        if (!strncmp((const char *) entry(i), name, SOUNDBANK_NAME_LEN)) return (i);
+    return (SOUNDBANK_NOT_FOUND);
+}
+
+const uint8_t * SoundBank::data(uint16_t id) const {
+    if (id >= entries) return (NULL);
+    return (image + get32(field(id, 0)));
+}
+
+uint32_t SoundBank::samples(uint16_t id) const {
+    return (id < entries ? get32(field(id, 4)) : 0);
+}
+
+uint16_t SoundBank::rate(uint16_t id) const {
+    return (id < entries ? get16(field(id, 8)) : 0);
+}
+
+uint8_t SoundBank::bits(uint16_t id) const {
+    return (id < entries ? field(id, 10)[0] : 0);
+}
+
+const char * SoundBank::name(uint16_t id) const {
+    if (id >= entries) return (NULL);
+    return ((const char *) entry(id));
+}
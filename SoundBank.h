@@ -0,0 +1,66 @@
+//
+//  SoundBank - index of FX stored in a binary bank image
+//  part of the ESP32Sound library, https://github.com/ChrisVeigl/ESP32Sound
+//
+//  A bank image contains many FX and an index, so that FX can be played by id (O(1))
+//  or by name. The image can live in a data partition which is memory-mapped 
+//  (see ESP32Sound::loadFxBank()), or it is compiled into the application as one packed 
+//  array or via .incbin. The voices read the samples in place, so a bank needs no RAM.
+//  Bank images are created with convertTool/wav2bank.py.
+//  This file is plain C++ (no Arduino / FreeRTOS dependencies).
+//
+//  Image layout (all values little endian):
+//    0: "SFXB", 4: version (2 bytes), 6: number of FX (2 bytes)
+//    8: index entries of SOUNDBANK_ENTRY_SIZE bytes: name (0-terminated), offset of the data (4 bytes),
+//       number of samples (4 bytes), sampling rate (2 bytes), bits per sample (1 byte), 0
+//    sample data, every FX starts at a 4-byte boundary: 8 bits: unsigned samples, 
+//    4 bits (IMA-ADPCM): start predictor (2 bytes), step index, 0, then 2 samples per byte (low nibble first)
+//
+//  This code is released under GPLv3 license.
+//  see: https://www.gnu.org/licenses/gpl-3.0.en.html and https://www.fsf.org/
+
+#ifndef _SoundBank_H_
+#define _SoundBank_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SOUNDBANK_MAGIC "SFXB"
+#define SOUNDBANK_VERSION 2
+#define SOUNDBANK_HEADER_SIZE 8
+#define SOUNDBANK_NAME_LEN 20
+#define SOUNDBANK_ENTRY_SIZE (SOUNDBANK_NAME_LEN+12)
+#define SOUNDBANK_BITS_PCM 8
+#define SOUNDBANK_BITS_ADPCM 4
+#define SOUNDBANK_NOT_FOUND -1
+
+class SoundBank {
+
+  public:
+    SoundBank() : image(NULL), imageSize(0), entries(0) {}
+
+    // use the bank image at the given address (eg. a mapped partition), returns false if it is not valid
+    bool attach(const uint8_t * data, uint32_t size);
+#if !defined(ESP32)
+    // host builds (tests, tools): map a bank image file with POSIX mmap
+    bool mapFile(const char * path);
+#endif
+    bool valid() const { return (image != NULL); }
+    uint16_t count() const { return (entries); }
+    int16_t find(const char * name) const;      // id of the FX with the given name, or SOUNDBANK_NOT_FOUND
+    const uint8_t * data(uint16_t id) const;    // sample data, NULL if the id is not valid
+    uint32_t samples(uint16_t id) const;
+    uint16_t rate(uint16_t id) const;
+    uint8_t bits(uint16_t id) const;            // SOUNDBANK_BITS_PCM or SOUNDBANK_BITS_ADPCM
+    const char * name(uint16_t id) const;
+
+  private:
+    const uint8_t * entry(uint16_t id) const { return (image + SOUNDBANK_HEADER_SIZE + (uint32_t)id*SOUNDBANK_ENTRY_SIZE); }
+    const uint8_t * field(uint16_t id, uint8_t ofs) const { return (entry(id) + SOUNDBANK_NAME_LEN + ofs); }
+
+    const uint8_t * image;
+    uint32_t        imageSize;
+    uint16_t        entries;
+};
+
+#endif
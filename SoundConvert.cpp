@@ -0,0 +1,90 @@
+//
+//  SoundConvert - bulk PCM format conversion kernels
+//  part of the ESP32Sound library, https://github.com/ChrisVeigl/ESP32Sound
+//
+//  On the ESP32 (Xtensa, no SIMD) the kernels work on 32-bit words (loads and stores 
+//  via memcpy, which compiles to single word accesses and avoids alignment traps) and 
+//  handle the remaining samples one by one. On other CPUs the plain loops are used,
+//  the compiler vectorizes them (see tests/bench_convert). SOUND_CONVERT_WORDS selects
+//  the word-wise kernels on other CPUs (for the host tests).
+//  An 8-bit sample is converted by flipping the sign bit and moving it to the 
+//  high byte ((val-128)*256), 16-bit samples are used as they are.
+//  All kernels assume a little-endian CPU (ESP32 / x86 / ARM).
+//
+//  This code is released under GPLv3 license.
+//  see: https://www.gnu.org/licenses/gpl-3.0.en.html and https://www.fsf.org/
+
+#include <string.h>
+#include "SoundConvert.h"
+
+#if defined(__XTENSA__) || defined(SOUND_CONVERT_WORDS)
+
+static inline uint32_t load32(const uint8_t * p) { uint32_t w; memcpy(&w, p, 4); return(w); }
+static inline void store32(uint8_t * p, uint32_t w) { memcpy(p, &w, 4); }
+
+// 4 unsigned 8-bit samples (one word) to 4 signed 16-bit samples (two words)
+static inline void expand4(uint32_t a, int16_t * out) {
+    uint32_t x = a ^ 0x80808080;
+    store32((uint8_t *) out, ((x & 0xff) << 8) | ((x & 0xff00) << 16));
+    store32((uint8_t *) (out+2), ((x >> 8) & 0xff00) | (x & 0xff000000));
+}
+
+uint32_t u8_mono_to_s16_mono(const uint8_t * in, int16_t * out, uint32_t n) {
+    uint32_t i=0;
+    for (; i+4<=n; i+=4) expand4(load32(in+i), out+i);
+    for (; i<n; i++) out[i]=(int16_t)((in[i] ^ 0x80) << 8);
+    return(n);
+}
+
+uint32_t u8_stereo_to_s16_mono(const uint8_t * in, int16_t * out, uint32_t n) {
+    uint32_t i=0;
+    for (; i+4<=n; i+=4) {
+        uint32_t a=load32(in+2*i), b=load32(in+2*i+4);
+        expand4((a & 0xff) | ((a >> 8) & 0xff00) | ((b & 0xff) << 16) | ((b & 0xff0000) << 8), out+i);
+    }
+    for (; i<n; i++) out[i]=(int16_t)((in[2*i] ^ 0x80) << 8);
+    return(n);
+}
+
+#else
+
+uint32_t u8_mono_to_s16_mono(const uint8_t * in, int16_t * out, uint32_t n) {
+    for (uint32_t i=0; i<n; i++) out[i]=(int16_t)((in[i] ^ 0x80) << 8);
+    return(n);
+}
+
+uint32_t u8_stereo_to_s16_mono(const uint8_t * in, int16_t * out, uint32_t n) {
+    for (uint32_t i=0; i<n; i++) out[i]=(int16_t)((in[2*i] ^ 0x80) << 8);
+    return(n);
+}
+
+#endif
+
+uint32_t s16le_mono_to_s16_mono(const uint8_t * in, int16_t * out, uint32_t n) {
+    memcpy(out, in, 2*n);
+    return(n);
+}
+
+uint32_t s16le_stereo_to_s16_mono(const uint8_t * in, int16_t * out, uint32_t n) {
+    uint32_t i=0;
+#if defined(__XTENSA__) || defined(SOUND_CONVERT_WORDS)
+    for (; i+2<=n; i+=2) {
+        uint32_t a=load32(in+4*i), b=load32(in+4*i+4);
+        store32((uint8_t *) (out+i), (a & 0xffff) | (b << 16));
+    }
+#endif
+    for (; i<n; i++) out[i]=(int16_t)(in[4*i] | (in[4*i+1] << 8));
+    return(n);
+}
+
+soundConvertFunc getSoundConverter(uint16_t bits, uint16_t channels) {
+    if (bits==8) {
+        if (channels==1) return(u8_mono_to_s16_mono);
+        if (channels==2) return(u8_stereo_to_s16_mono);
+    }
+    else if (bits==16) {
+        if (channels==1) return(s16le_mono_to_s16_mono);
+        if (channels==2) return(s16le_stereo_to_s16_mono);
+    }
+    return(NULL);
+}
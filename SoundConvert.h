@@ -0,0 +1,29 @@
+//
+//  SoundConvert - bulk PCM format conversion kernels
+//  part of the ESP32Sound library, https://github.com/ChrisVeigl/ESP32Sound
+//
+//  Each kernel converts n frames of a .wav sample layout into 16-bit signed
+//  mono samples (the format of the mix bus) and returns the number of samples written.
+//  The stream decoder selects one kernel per file with getSoundConverter(),
+//  so there is no per-sample format branch.
+//  This file is plain C++ (no Arduino / FreeRTOS dependencies).
+//
+//  This code is released under GPLv3 license.
+//  see: https://www.gnu.org/licenses/gpl-3.0.en.html and https://www.fsf.org/
+
+#ifndef _SoundConvert_H_
+#define _SoundConvert_H_
+
+#include <stdint.h>
+
+typedef uint32_t (*soundConvertFunc)(const uint8_t * in, int16_t * out, uint32_t n);
+
+uint32_t u8_mono_to_s16_mono(const uint8_t * in, int16_t * out, uint32_t n);
+uint32_t u8_stereo_to_s16_mono(const uint8_t * in, int16_t * out, uint32_t n);     // uses the left channel
+uint32_t s16le_mono_to_s16_mono(const uint8_t * in, int16_t * out, uint32_t n);
+uint32_t s16le_stereo_to_s16_mono(const uint8_t * in, int16_t * out, uint32_t n);  // uses the left channel
+
+// returns the kernel for the given layout, or NULL if the layout is not supported
+soundConvertFunc getSoundConverter(uint16_t bits, uint16_t channels);
+
+#endif
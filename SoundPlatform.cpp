@@ -0,0 +1,77 @@
+//
+//  SoundPlatform - hardware access of the ESP32Sound library (ESP32 implementation)
+//  part of the ESP32Sound library, https://github.com/ChrisVeigl/ESP32Sound
+//
+//  This code is released under GPLv3 license.
+//  see: https://www.gnu.org/licenses/gpl-3.0.en.html and https://www.fsf.org/
+
+#if defined(ESP32)
+
+#include <Arduino.h>
+#include <driver/i2s.h>
+#include <esp_partition.h>
+#include "SoundPlatform.h"
+
+static hw_timer_t * timer = NULL;
+
+void soundPlatformInit(){
+    pinMode(AMP_PIN, OUTPUT);
+    digitalWrite(AMP_PIN, HIGH);
+}
+
+// the mapping is never released: FX banks stay mapped while the application runs
+const uint8_t * soundMapPartition(const char * label, uint32_t & size){
+    const esp_partition_t * part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+    const void * ptr;
+    spi_flash_mmap_handle_t handle;
+    if ((part == NULL) || (esp_partition_mmap(part, 0, part->size, SPI_FLASH_MMAP_DATA, &ptr, &handle) != ESP_OK))
+        return(NULL);
+    size=part->size;
+    return((const uint8_t *) ptr);
+}
+
+void soundTimerBegin(void (*isr)(), uint32_t rate){
+    dacWrite(DAC_PIN, 127);
+    timer = timerBegin(0, 80, true);   // prescaler 80 : 1MHz
+    timerAlarmDisable(timer);
+    timerAttachInterrupt(timer, isr, true);
+    soundTimerSetRate(rate);
+}
+
+void soundTimerSetRate(uint32_t rate){
+    timerAlarmWrite(timer, 1000000/rate, true);
+}
+
+void soundTimerEnable(){
+    timerAlarmEnable(timer);
+}
+
+void IRAM_ATTR soundTimerDisable(){
+    timerAlarmDisable(timer);
+}
+
+void soundI2SBegin(uint32_t rate, uint16_t blockSize){
+    i2s_config_t i2sConfig;
+    memset(&i2sConfig, 0, sizeof(i2sConfig));
+    i2sConfig.mode = (i2s_mode_t) (I2S_MODE_MASTER | I2S_MODE_TX | I2S_MODE_DAC_BUILT_IN);
+    i2sConfig.sample_rate = rate;
+    i2sConfig.bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT;
+    i2sConfig.channel_format = I2S_CHANNEL_FMT_RIGHT_LEFT;
+    i2sConfig.communication_format = I2S_COMM_FORMAT_I2S_MSB;
+    i2sConfig.dma_buf_count = I2S_DMA_BUFFERS;
+    i2sConfig.dma_buf_len = blockSize;
+    i2s_driver_install(I2S_NUM_0, &i2sConfig, 0, NULL);
+    i2s_set_pin(I2S_NUM_0, NULL);
+    i2s_set_dac_mode(I2S_DAC_CHANNEL_LEFT_EN);   // DAC2 (pin 26) only, pin 25 is the amplifier enable
+}
+
+void soundI2SSetRate(uint32_t rate){
+    i2s_set_sample_rates(I2S_NUM_0, rate);
+}
+
+void soundI2SWrite(const uint16_t * frames, uint16_t count){
+    size_t written;
+    i2s_write(I2S_NUM_0, frames, count*2*sizeof(uint16_t), &written, portMAX_DELAY);
+}
+
+#endif
@@ -0,0 +1,47 @@
+//
+//  SoundPlatform - hardware access of the ESP32Sound library
+//  part of the ESP32Sound library, https://github.com/ChrisVeigl/ESP32Sound
+//
+//  All accesses to the DAC, the sample timer, the I2S peripheral and the cycle counter
+//  are made through these functions. The mixer, the decoders and the stream tasks
+//  do not touch hardware registers directly, so a port to another platform 
+//  only needs another implementation of SoundPlatform.cpp. The host build of the 
+//  tests uses tests/host/SoundPlatformHost.cpp (virtual-clock timer, captured DAC).
+//
+//  This code is released under GPLv3 license.
+//  see: https://www.gnu.org/licenses/gpl-3.0.en.html and https://www.fsf.org/
+
+#ifndef _SoundPlatform_H_
+#define _SoundPlatform_H_
+
+#include <Arduino.h>
+#include "ESP32Sound.h"
+
+// amplifier on, DAC to midpoint
+void soundPlatformInit();
+
+// write one sample to the DAC (called from the timer ISR)
+static inline void IRAM_ATTR soundDacWrite(uint8_t value) { dacWrite(DAC_PIN, value); }
+
+// CPU cycle counter (same as ESP.getCycleCount(), but usable in the ISR)
+#if defined(ESP32)
+static inline uint32_t IRAM_ATTR soundCycleCount() { uint32_t c; asm volatile("rsr %0, ccount" : "=a"(c)); return(c); }
+#else
+uint32_t soundCycleCount();   // host: time stamp counter
+#endif
+
+// memory-map a data partition (read only), returns NULL if the partition was not found
+const uint8_t * soundMapPartition(const char * label, uint32_t & size);
+
+// sample timer: calls isr with the given rate when enabled
+void soundTimerBegin(void (*isr)(), uint32_t rate);
+void soundTimerSetRate(uint32_t rate);
+void soundTimerEnable();
+void soundTimerDisable();
+
+// I2S in built-in-DAC mode, frames are 16-bit stereo samples (upper byte is used by the DAC)
+void soundI2SBegin(uint32_t rate, uint16_t blockSize);
+void soundI2SSetRate(uint32_t rate);
+void soundI2SWrite(const uint16_t * frames, uint16_t count);   // blocks until DMA buffer space is free
+
+#endif
@@ -0,0 +1,80 @@
+//
+//  SoundResampler - streaming sample rate converter
+//  part of the ESP32Sound library, https://github.com/ChrisVeigl/ESP32Sound
+//
+//  This code is released under GPLv3 license.
+//  see: https://www.gnu.org/licenses/gpl-3.0.en.html and https://www.fsf.org/
+
+#include <math.h>
+#include "SoundResampler.h"
+
+void SoundResampler::reset() {
+    for (uint8_t i=0; i<2*RESAMPLE_TAPS; i++) hist[i]=0;
+    idx=0;
+    pos=0;
+}
+
+void SoundResampler::setup(uint32_t inRate, uint32_t outRate, uint8_t q) {
+    quality = q;
+    setRate(inRate, outRate);
+    reset();
+}
+
+void SoundResampler::setRate(uint32_t inRate, uint32_t outRate) {
+    step = (uint32_t)(((uint64_t)inRate << 16) / outRate);
+    if (quality != RESAMPLE_FIR) return;
+
+    // windowed-sinc lowpass, cutoff at the lower of both nyquist frequencies
+    double fc = (inRate > outRate) ? (double)outRate/inRate : 1.0;
+    for (uint8_t p=0; p<RESAMPLE_PHASES; p++) {
+        double frac = (double)p / RESAMPLE_PHASES, sum=0, c[RESAMPLE_TAPS];
+        for (uint8_t k=0; k<RESAMPLE_TAPS; k++) {
+            double x = k - (RESAMPLE_TAPS/2 - 1) - frac;     // output lies between taps TAPS/2-1 and TAPS/2
+            double s = (x == 0) ? 1.0 : sin(M_PI*fc*x) / (M_PI*fc*x);
+            double w = 0.5 + 0.5*cos(M_PI*x / (RESAMPLE_TAPS/2));   // hann window
+            c[k] = s*w;
+            sum += c[k];
+        }
+        for (uint8_t k=0; k<RESAMPLE_TAPS; k++)      // normalize to unity gain
+            coef[p][k] = (int16_t) lround(c[k] / sum * (1<<RESAMPLE_COEF_SHIFT));
+    }
+}
+
+inline int16_t SoundResampler::interpolate() const {
+    const int16_t * h = hist + idx;     // h[0] is the oldest, h[TAPS-1] the newest sample
+    int32_t v;
+    if (quality == RESAMPLE_FIR) {
+        const int16_t * c = coef[pos >> (16-RESAMPLE_PHASE_BITS)];
+        v = 0;
+        for (uint8_t k=0; k<RESAMPLE_TAPS; k++) v += h[k] * c[k];
+        v >>= RESAMPLE_COEF_SHIFT;
+    }
+    else {
+        int32_t a = h[RESAMPLE_TAPS-2], b = h[RESAMPLE_TAPS-1];
+        v = a + (((b - a) * (int32_t)(pos >> 2)) >> 14);     // pos < 2^16, the product fits 32 bits
+    }
+    if (v < -32768) v = -32768;
+    if (v > 32767) v = 32767;
+    return ((int16_t)v);
+}
+
+uint32_t SoundResampler::process(const int16_t * in, uint32_t inCount, uint32_t & consumed, int16_t * out, uint32_t outMax) {
+    uint32_t n=0, i=0;
+    while (1) {
+        // produce all output samples which lie before the next input sample
+        while (pos < (1<<16)) {
+            if (n >= outMax) {
+                consumed = i;
+                return (n);
+            }
+            out[n++] = interpolate();
+            pos += step;
+        }
+        if (i >= inCount) break;
+        hist[idx] = hist[idx + RESAMPLE_TAPS] = in[i++];
+        idx = (idx + 1) % RESAMPLE_TAPS;
+        pos -= (1<<16);
+    }
+    consumed = i;
+    return (n);
+}
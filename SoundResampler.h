@@ -0,0 +1,55 @@
+//
+//  SoundResampler - streaming sample rate converter
+//  part of the ESP32Sound library, https://github.com/ChrisVeigl/ESP32Sound
+//
+//  Converts a stream of 16-bit signed mono samples from the sampling rate of a 
+//  .wav file to the playback rate of the engine. Two quality levels are available:
+//  linear interpolation (RESAMPLE_LINEAR) and a polyphase windowed-sinc FIR filter
+//  with RESAMPLE_TAPS taps and RESAMPLE_PHASES phases (RESAMPLE_FIR), which also
+//  acts as anti-aliasing filter when downsampling.
+//  The position is kept as Q16 fixed-point value, the FIR coefficients are 
+//  calculated once in setup(). This file is plain C++ (no Arduino / FreeRTOS dependencies).
+//
+//  This code is released under GPLv3 license.
+//  see: https://www.gnu.org/licenses/gpl-3.0.en.html and https://www.fsf.org/
+
+#ifndef _SoundResampler_H_
+#define _SoundResampler_H_
+
+#include <stdint.h>
+
+#define RESAMPLE_LINEAR 0
+#define RESAMPLE_FIR    1
+#define RESAMPLE_TAPS   8
+#define RESAMPLE_PHASE_BITS 5
+#define RESAMPLE_PHASES (1<<RESAMPLE_PHASE_BITS)
+#define RESAMPLE_COEF_SHIFT 14    // FIR coefficients are Q14 values
+
+class SoundResampler {
+
+  public:
+    SoundResampler() : step(1<<16), pos(0), idx(0), quality(RESAMPLE_LINEAR) { reset(); }
+
+    // prepare conversion from inRate to outRate (samples/sec)
+    void setup(uint32_t inRate, uint32_t outRate, uint8_t q);
+    // change the rates while converting (the input history is kept, no click)
+    void setRate(uint32_t inRate, uint32_t outRate);
+    // true if the rates differ, otherwise the samples can be used as they are
+    bool active() const { return (step != (1<<16)); }
+    // converts up to inCount samples, writes at most outMax samples to out.
+    // returns the number of output samples, consumed is set to the number of used input samples
+    uint32_t process(const int16_t * in, uint32_t inCount, uint32_t & consumed, int16_t * out, uint32_t outMax);
+
+  private:
+    void reset();
+    int16_t interpolate() const;
+
+    uint32_t step;                            // input samples per output sample (Q16)
+    uint32_t pos;                             // position of the next output sample after the newest input (Q16)
+    uint8_t  idx;                             // write index into hist
+    uint8_t  quality;
+    int16_t  hist[2*RESAMPLE_TAPS];           // input history, every sample is stored twice (no wrap-around)
+    int16_t  coef[RESAMPLE_PHASES][RESAMPLE_TAPS];
+};
+
+#endif
@@ -0,0 +1,120 @@
+//
+//  SoundRing - lock-free single-producer / single-consumer ring buffer
+//  part of the ESP32Sound library, https://github.com/ChrisVeigl/ESP32Sound
+//
+//  The producer (eg. the stream task) copies whole chunks into the ring and
+//  publishes them with a single index update, the consumer (eg. the timer ISR)
+//  just reads the write index and one element. No locks or kernel calls are used.
+//  writePtr()/commit() and readPtr()/consume() give direct access to contiguous
+//  parts of the buffer, so that data can be read / decoded in place.
+//  The capacity is rounded up to a power of two, so that head and tail can
+//  run freely and are only masked when the buffer is accessed.
+//  This file is plain C++ (no Arduino / FreeRTOS dependencies).
+//
+//  This code is released under GPLv3 license.
+//  see: https://www.gnu.org/licenses/gpl-3.0.en.html and https://www.fsf.org/
+
+#ifndef _SoundRing_H_
+#define _SoundRing_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+template <typename T> class SoundRing {
+
+  public:
+    SoundRing() : data(NULL), mask(0), head(0), tail(0) {}
+
+    // allocate the buffer (at least minSize elements), returns false if out of memory
+    bool allocate(uint32_t minSize) {
+        uint32_t s=1;
+        while (s < minSize) s<<=1;
+        free(data);
+        data = (T *) calloc(s, sizeof(T));
+        mask = data ? s-1 : 0;
+        head = tail = 0;
+        return (data != NULL);
+    }
+
+    uint32_t size() const { return (data ? mask+1 : 0); }
+
+    // number of elements ready for the consumer (safe from both sides)
+    uint32_t available() const {
+        return (__atomic_load_n(&head, __ATOMIC_ACQUIRE) - __atomic_load_n(&tail, __ATOMIC_ACQUIRE));
+    }
+
+    // number of free elements for the producer (safe from both sides)
+    uint32_t space() const { return (size() - available()); }
+
+    // producer: drop all pending elements (only while the consumer is not reading!)
+    void clear() {
+        __atomic_store_n(&head, __atomic_load_n(&tail, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+    }
+
+    // drop all elements and continue at the start of the buffer, so that the n-th element 
+    // written is stored at offset n (only while neither producer nor consumer access the ring!)
+    void reset() {
+        __atomic_store_n(&head, 0, __ATOMIC_RELEASE);
+        __atomic_store_n(&tail, 0, __ATOMIC_RELEASE);
+    }
+
+    // producer: copy up to n elements into the ring, returns number of elements written
+    uint32_t write(const T * src, uint32_t n) {
+        uint32_t h = head;
+        uint32_t room = size() - (h - __atomic_load_n(&tail, __ATOMIC_ACQUIRE));
+        if (n > room) n = room;
+        uint32_t pos = h & mask;
+        uint32_t first = mask + 1 - pos;
+        if (first > n) first = n;
+        memcpy(data + pos, src, first * sizeof(T));
+        memcpy(data, src + first, (n - first) * sizeof(T));
+        __atomic_store_n(&head, h + n, __ATOMIC_RELEASE);   // publish the whole chunk at once
+        return (n);
+    }
+
+    // producer: get the contiguous free space (n is set to its size), fill it and call commit()
+    T * writePtr(uint32_t & n) {
+        uint32_t h = head;
+        uint32_t pos = h & mask;
+        n = size() - (h - __atomic_load_n(&tail, __ATOMIC_ACQUIRE));
+        if (n > mask + 1 - pos) n = mask + 1 - pos;
+        return (data + pos);
+    }
+
+    // producer: publish n elements written via writePtr()
+    void commit(uint32_t n) {
+        __atomic_store_n(&head, head + n, __ATOMIC_RELEASE);
+    }
+
+    // consumer: get the contiguous readable elements (n is set to their number), call consume() afterwards
+    const T * readPtr(uint32_t & n) {
+        uint32_t t = tail;
+        uint32_t pos = t & mask;
+        n = __atomic_load_n(&head, __ATOMIC_ACQUIRE) - t;
+        if (n > mask + 1 - pos) n = mask + 1 - pos;
+        return (data + pos);
+    }
+
+    // consumer: release n elements obtained via readPtr()
+    void consume(uint32_t n) {
+        __atomic_store_n(&tail, tail + n, __ATOMIC_RELEASE);
+    }
+
+    // consumer: read one element, returns false if the ring is empty
+    inline bool read(T & value) {
+        uint32_t t = tail;
+        if (__atomic_load_n(&head, __ATOMIC_ACQUIRE) == t) return (false);
+        value = data[t & mask];
+        __atomic_store_n(&tail, t + 1, __ATOMIC_RELEASE);
+        return (true);
+    }
+
+  private:
+    T *      data;
+    uint32_t mask;
+    uint32_t head;   // written by the producer only
+    uint32_t tail;   // written by the consumer only
+};
+
+#endif
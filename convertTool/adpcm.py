@@ -0,0 +1,129 @@
+#
+#  IMA-ADPCM encoder (4 bits per sample) for the ESP32Sound library
+#  used by wav2wav.py (IMA-ADPCM .wav files, format tag 0x11) 
+#  and by wav2array.py (compressed FX arrays)
+#  the encoder uses the decoder to track the predictor, so there is no drift.
+#
+
+import struct
+
+STEP_TABLE = [
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487,
+    12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767]
+
+INDEX_TABLE = [-1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8]
+
+
+def decode_nibble(nibble, predictor, index):
+    step = STEP_TABLE[index]
+    diff = step >> 3
+    if nibble & 1: diff += step >> 2
+    if nibble & 2: diff += step >> 1
+    if nibble & 4: diff += step
+    if nibble & 8: diff = -diff
+    predictor = max(-32768, min(32767, predictor + diff))
+    index = max(0, min(88, index + INDEX_TABLE[nibble]))
+    return predictor, index
+
+
+def encode_nibble(sample, predictor, index):
+    step = STEP_TABLE[index]
+    diff = sample - predictor
+    nibble = 0
+    if diff < 0:
+        nibble = 8
+        diff = -diff
+    if diff >= step:
+        nibble |= 4
+        diff -= step
+    if diff >= step >> 1:
+        nibble |= 2
+        diff -= step >> 1
+    if diff >= step >> 2:
+        nibble |= 1
+    predictor, index = decode_nibble(nibble, predictor, index)
+    return nibble, predictor, index
+
+
+def samples_per_block(blockAlign):
+    return (blockAlign - 4) * 2 + 1
+
+
+def encode_blocks(samples, blockAlign=256):
+    # encodes a list of 16-bit mono samples into IMA-ADPCM blocks (returns bytes)
+    spb = samples_per_block(blockAlign)
+    out = bytearray()
+    index = 0
+    for start in range(0, len(samples), spb):
+        block = list(samples[start:start + spb])
+        block += [block[-1]] * (spb - len(block))     # pad the last block
+        predictor = block[0]
+        out += struct.pack('<hBB', predictor, index, 0)
+        nibbles = []
+        for s in block[1:]:
+            nibble, predictor, index = encode_nibble(s, predictor, index)
+            nibbles.append(nibble)
+        for i in range(0, len(nibbles), 2):
+            out.append(nibbles[i] | (nibbles[i + 1] << 4))
+    return bytes(out)
+
+
+def write_wav(fileName, samples, rate, blockAlign=256):
+    # writes 16-bit mono samples as IMA-ADPCM .wav file
+    data = encode_blocks(samples, blockAlign)
+    spb = samples_per_block(blockAlign)
+    fmt = struct.pack('<HHIIHHHH', 0x11, 1, rate, rate * blockAlign // spb, blockAlign, 4, 2, spb)
+    fact = struct.pack('<I', len(samples))
+    with open(fileName, 'wb') as f:
+        f.write(b'RIFF')
+        f.write(struct.pack('<I', 4 + 8 + len(fmt) + 8 + len(fact) + 8 + len(data)))
+        f.write(b'WAVE')
+        f.write(b'fmt ' + struct.pack('<I', len(fmt)) + fmt)
+        f.write(b'fact' + struct.pack('<I', len(fact)) + fact)
+        f.write(b'data' + struct.pack('<I', len(data)) + data)
+
+
+# FX header: bytes 0-2 number of samples (low byte first), byte 3 flags
+# (bit 7: extended header, bits 4-6: header version, bits 0-3: sample format)
+FX_FLAG_EXTENDED = 0x80
+FX_HEADER_VERSION = 1
+FX_FORMAT_ADPCM4 = 1
+
+
+def best_start_index(samples):
+    # step index which gives the smallest error for the first samples (fast attack)
+    best, bestErr = 0, None
+    for index in range(89):
+        predictor, i, err = samples[0], index, 0
+        for s in samples[:64]:
+            nibble, predictor, i = encode_nibble(s, predictor, i)
+            err += abs(s - predictor)
+        if bestErr is None or err < bestErr:
+            best, bestErr = index, err
+    return best
+
+
+def encode_fx(samples):
+    # encodes 8-bit unsigned samples as compressed FX array: header, start predictor / step index, nibbles
+    n = len(samples)
+    if n >= (1 << 24):
+        raise ValueError('FX too long for compressed format')
+    s16 = [(s - 128) << 8 for s in samples]
+    index = best_start_index(s16)
+    predictor = s16[0]
+    out = bytearray([n & 0xff, (n >> 8) & 0xff, (n >> 16) & 0xff,
+                     FX_FLAG_EXTENDED | (FX_HEADER_VERSION << 4) | FX_FORMAT_ADPCM4])
+    out += struct.pack('<hBB', predictor, index, 0)
+    nibbles = []
+    for s in s16:
+        nibble, predictor, index = encode_nibble(s, predictor, index)
+        nibbles.append(nibble)
+    if len(nibbles) % 2:
+        nibbles.append(0)
+    for i in range(0, len(nibbles), 2):
+        out.append(nibbles[i] | (nibbles[i + 1] << 4))
+    return bytes(out)
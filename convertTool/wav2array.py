@@ -1,7 +1,9 @@
 #
 #  convert .wav files to c-arrays (16KHz, mono, 8bit format)
-#  usage: python wav2array.py file1.wav file2.wav ...
+#  usage: python wav2array.py [--adpcm] file1.wav file2.wav ...
 #  the converter will create the file sounds.h with respective c-array definitions.
+#  with option --adpcm the FX are stored compressed (IMA-ADPCM, 4 bits per sample),
+#  they are decoded by the mixer while playing. A flash size report is printed at the end.
 #
 #  thanks to:
 #  https://stackoverflow.com/questions/30619740/python-downsampling-wav-audio-file
@@ -12,9 +14,13 @@ import sys
 import os
 import wave
 import audioop
+import adpcm
 
-arguments=sys.argv
+arguments=[a for a in sys.argv if a != '--adpcm']
+useAdpcm='--adpcm' in sys.argv
 outFile ='sounds.h'
+pcmTotal=0
+flashTotal=0
 with open(outFile,'w') as out:
     out.write('#include <pgmspace.h>\n\n');
     for i in range(1, len(arguments)):
@@ -36,10 +42,10 @@ with open(outFile,'w') as out:
 
         try:
             print ('converting to 16KHz!')
-            converted = audioop.ratecv(data, bytes, inchannels, inrate, 16000, None)
+            converted = audioop.ratecv(data, bytes, inchannels, inrate, 16000, None)[0]
             if (inchannels == 2):
                 print ('converting to mono!')
-                converted = audioop.tomono(converted[0], bytes, 1, 0)
+                converted = audioop.tomono(converted, bytes, 1, 0)
             if (bytes > 1):
                 print ('converting to 8-bit representation!')
                 converted = audioop.lin2lin(converted, bytes, 1)
@@ -63,17 +69,25 @@ with open(outFile,'w') as out:
         out.write('[] PROGMEM={');
 
         length=len(converted)
-        lowbyte= length & 0xff
-        out.write(str(lowbyte)+' , ');
-        length=length>>8
-        lowbyte= length & 0xff
-        out.write(str(lowbyte)+' , ');
-        length=length>>8
-        lowbyte= length & 0xff
-        out.write(str(lowbyte)+' , ');
-        length=length>>8
-        lowbyte= length & 0xff
-        out.write(str(lowbyte)+' , ');
+        if useAdpcm:
+            encoded = bytearray(adpcm.encode_fx(ascii))
+            ascii = list(encoded)
+        else:
+            lowbyte= length & 0xff
+            out.write(str(lowbyte)+' , ');
+            length=length>>8
+            lowbyte= length & 0xff
+            out.write(str(lowbyte)+' , ');
+            length=length>>8
+            lowbyte= length & 0xff
+            out.write(str(lowbyte)+' , ');
+            length=length>>8
+            lowbyte= length & 0xff
+            out.write(str(lowbyte)+' , ');
+        flashSize = len(ascii) if useAdpcm else len(ascii)+4
+        print ('flash size of '+arrayName+': '+str(flashSize)+' bytes (8-bit PCM: '+str(len(converted)+4)+' bytes)')
+        pcmTotal+=len(converted)+4
+        flashTotal+=flashSize
 
         for row in ascii:
             out.write('{0},'.format(row))
@@ -83,6 +97,7 @@ with open(outFile,'w') as out:
                 cnt=0
         out.write('};')
         out.write('\n\n')
+    print ('total flash size: '+str(flashTotal)+' bytes (8-bit PCM: '+str(pcmTotal)+' bytes)')
     try:
         out.close()
     except:
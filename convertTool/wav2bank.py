@@ -0,0 +1,109 @@
+#
+#  convert .wav files to an FX bank (mono, 8bit or IMA-ADPCM format)
+#  usage: python wav2bank.py [--adpcm] [--array] [--rate=16000] file1.wav file2.wav ...
+#  the converter creates the bank image sounds.bin and the header file soundbank.h,
+#  which defines the id of each FX (eg. FX_FILE1 for file1.wav).
+#  The bank can be flashed into a data partition, eg. add this line to partitions.csv: 
+#    sounds, data, 0x40, , 256K
+#  and write the image with: parttool.py write_partition --partition-name=sounds --input sounds.bin
+#  In the sketch, use ESP32Sound.loadFxBank(bank, "sounds") and ESP32Sound.playFx(bank, FX_FILE1)
+#  or ESP32Sound.playFx(bank, "file1").
+#  With option --array, soundbank.h also contains the whole bank as one packed array (soundbank[]), 
+#  use bank.attach((const uint8_t *) soundbank, sizeof(soundbank)) in the sketch.
+#  With option --adpcm the FX are stored compressed (IMA-ADPCM, 4 bits per sample).
+#  For the image format see SoundBank.h
+#  Runs with python 2 and python 3 (up to 3.12, audioop).
+#
+
+
+import sys
+import os
+import struct
+import wave
+import audioop
+import adpcm
+
+NAME_LEN=20
+HEADER_SIZE=8
+ENTRY_SIZE=NAME_LEN+12
+
+def convert(fileName, rate):
+    try:
+        s_read = wave.open(fileName, 'rb')
+    except:
+        print ('Failed to open file!')
+        quit()
+
+    data = s_read.readframes(s_read.getnframes())
+    inchannels=s_read.getnchannels()
+    bytes=s_read.getsampwidth()
+    inrate=s_read.getframerate()
+    s_read.close()
+    print ('File has '+str(inchannels)+' channels,'+str(bytes)+' bytes per sample and rate '+str(inrate))
+
+    try:
+        converted = audioop.ratecv(data, bytes, inchannels, inrate, rate, None)[0]
+        if (inchannels == 2):
+            converted = audioop.tomono(converted, bytes, 1, 0)
+        if (bytes > 1):
+            converted = audioop.lin2lin(converted, bytes, 1)
+            converted = audioop.bias(converted, 1, 128)
+    except:
+        print ('Failed to downsample wav')
+        quit()
+    return list(bytearray(converted))
+
+options=[a for a in sys.argv[1:] if a.startswith('--')]
+arguments=[a for a in sys.argv[1:] if not a.startswith('--')]
+useAdpcm='--adpcm' in options
+useArray='--array' in options
+rate=16000
+for o in options:
+    if o.startswith('--rate='):
+        rate=int(o[7:])
+
+names=[]
+fxData=[]
+fxSamples=[]
+for fileName in arguments:
+    print ('Now processing file '+fileName)
+    samples=convert(fileName, rate)
+    if useAdpcm:
+        fx=bytearray(adpcm.encode_fx(samples))[4:]    # without the sounds.h length header
+    else:
+        fx=bytearray(samples)
+    names.append(os.path.splitext(os.path.basename(fileName))[0][:NAME_LEN-1])
+    fxData.append(fx)
+    fxSamples.append(len(samples))
+
+# index first, then the sample data (each FX aligned to 4 bytes)
+image=bytearray(b'SFXB')+bytearray(struct.pack('<HH', 2, len(fxData)))
+offset=HEADER_SIZE+ENTRY_SIZE*len(fxData)
+offsets=[]
+for fx in fxData:
+    offset=(offset+3) & ~3
+    offsets.append(offset)
+    offset+=len(fx)
+for i in range(len(fxData)):
+    image+=bytearray(names[i].ljust(NAME_LEN, '\0').encode('ascii'))
+    image+=bytearray(struct.pack('<IIHBB', offsets[i], fxSamples[i], rate, 4 if useAdpcm else 8, 0))
+for i in range(len(fxData)):
+    image+=bytearray(offsets[i]-len(image))
+    image+=fxData[i]
+image+=bytearray(-len(image) & 3)
+
+with open('sounds.bin','wb') as out:
+    out.write(image)
+with open('soundbank.h','w') as out:
+    out.write('// FX ids of sounds.bin, created by wav2bank.py\n\n')
+    for i in range(len(names)):
+        out.write('#define FX_'+''.join(c if c.isalnum() else '_' for c in names[i]).upper()+' '+str(i)+'\n')
+    if useArray:
+        # 32-bit words (little endian): less than 3 characters of source per byte
+        out.write('\n#include <pgmspace.h>\n\nconst uint32_t soundbank[] PROGMEM={\n')
+        for i in range(0, len(image), 32):
+            words=struct.unpack('<'+str(min(32, len(image)-i)//4)+'I', bytes(image[i:i+32]))
+            out.write(','.join('0x%08x' % w for w in words)+',\n')
+        out.write('};\n')
+print ('bank size: '+str(len(image))+' bytes, '+str(len(fxData))+' FX')
+print ('partition size needed: '+str((len(image)+4095)//4096*4)+'K')
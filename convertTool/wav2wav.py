@@ -1,7 +1,9 @@
 #
 #  convert .wav files to 16KHz, mono, 8bit format
-#  usage: python wav2wav.py file1.wav file2.wav ...
+#  usage: python wav2wav.py [--adpcm] file1.wav file2.wav ...
 #  the converter will create file1_conv.wav, file2_conv.wav, ...
+#  with option --adpcm the files are stored in 16KHz, mono, IMA-ADPCM format
+#  (4 bits per sample, 16-bit quality, half the SD bandwidth of 8bit files)
 #
 #  thanks to:
 #  https://stackoverflow.com/questions/30619740/python-downsampling-wav-audio-file
@@ -12,9 +14,12 @@ import sys
 import os
 import wave
 import audioop
+import struct
+import adpcm
 
 
-arguments=sys.argv
+arguments=[a for a in sys.argv if a != '--adpcm']
+useAdpcm='--adpcm' in sys.argv
 
 for i in range(1, len(arguments)):
     fileName=arguments[i] 
@@ -24,7 +29,8 @@ for i in range(1, len(arguments)):
         s_read = wave.open(fileName, 'rb')
         newName = fileName.partition(".")[0]
         newName=newName+'_conv.wav'
-        s_write = wave.open(newName, 'wb')
+        if not useAdpcm:
+            s_write = wave.open(newName, 'wb')
     except:
         print 'Failed to open file!'
         quit()
@@ -38,11 +44,16 @@ for i in range(1, len(arguments)):
 
     try:
         print ('converting to 16KHz!')
-        converted = audioop.ratecv(data, bytes, inchannels, inrate, 16000, None)
+        converted = audioop.ratecv(data, bytes, inchannels, inrate, 16000, None)[0]
         if (inchannels == 2):
             print ('converting to mono!')
-            converted = audioop.tomono(converted[0], bytes, 1, 0)
-        if (bytes > 1):
+            converted = audioop.tomono(converted, bytes, 1, 0)
+        if useAdpcm:
+            print ('converting to IMA-ADPCM representation!')
+            if (bytes == 1):
+                converted = audioop.bias(converted, 1, -128)
+            converted = audioop.lin2lin(converted, bytes, 2)
+        elif (bytes > 1):
             print ('converting to 8-bit representation!')
             converted = audioop.lin2lin(converted, bytes, 1)
             converted = audioop.bias(converted, 1, 128)
@@ -50,14 +61,19 @@ for i in range(1, len(arguments)):
         print 'Failed to downsample wav'
 
     try:
-        s_write.setparams((1, 1, 16000, 0, 'NONE', 'Uncompressed'))
-        s_write.writeframes(converted)
+        if useAdpcm:
+            samples = struct.unpack('<%dh' % (len(converted) // 2), converted)
+            adpcm.write_wav(newName, samples, 16000)
+        else:
+            s_write.setparams((1, 1, 16000, 0, 'NONE', 'Uncompressed'))
+            s_write.writeframes(converted)
     except:
         print 'Failed to write wav'
         quit()
 
     try:
         s_read.close()
-        s_write.close()
+        if not useAdpcm:
+            s_write.close()
     except:
         print 'Failed to close wav file'
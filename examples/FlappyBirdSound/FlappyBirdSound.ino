@@ -61,6 +61,7 @@ uint8_t letterIndex=0;
 uint8_t actFxVolume=20;
 uint8_t actSoundVolume=30;
 uint8_t soundAvailable=0;
+uint8_t musicQueued=0;
 
 
 //background
@@ -192,6 +193,7 @@ void setup() {
   ESP32Sound.begin(16000);
   ESP32Sound.setSoundVolume(actSoundVolume);
   ESP32Sound.setFxVolume(actFxVolume);
+  ESP32Sound.setLoop(true);    // the music file is repeated without a gap
 
   if (SD.exists(SOUNDFILE)) soundAvailable = 1; 
   gameInit();  
@@ -450,6 +452,7 @@ void update() {
     }
     if (gamePause) {
         ESP32Sound.stopSound();
+        musicQueued = 0;
         ESP32Sound.playFx(fx2);
     }
 
@@ -461,8 +464,9 @@ void gameLoop() {
   drawPipe();
   drawBird();
   drawScore();
-  if (soundAvailable && !ESP32Sound.isPlaying() && !gamePause) {
-    ESP32Sound.playSound(SD, SOUNDFILE);
+  if (soundAvailable && !musicQueued && !gamePause) {
+    ESP32Sound.enqueue(SD, SOUNDFILE);
+    musicQueued = 1;
   }
 }
 
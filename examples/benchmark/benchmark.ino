@@ -0,0 +1,136 @@
+//
+// Benchmark for the ESP32Sound library
+// https://github.com/ChrisVeigl/ESP32Sound
+//
+// This sketch measures the CPU cycles of the mixer (per timer interrupt) and the
+// throughput of the streaming pipeline (SD reads and decoding) for a set of scenarios.
+// Test files in all supported .wav formats are created on the SD card at startup.
+// Results are printed as CSV lines (prefixed with "CSV,") so that they can be
+// collected from the serial log and compared between releases.
+// The frame scenarios simulate a busy game loop and measure its frame rate and the audio 
+// underruns, with and without sound. Build once with PINNED_PIPELINE 1 and once with 0 to 
+// compare the pinned pipeline (decoding on core 0) with tasks that run on any core.
+//
+
+
+#include <SD.h>
+#include "ESP32Sound.h"
+#include "scenarios.h"    // the scenario table and the test files (shared with tests/bench_scenarios.cpp)
+
+#define FRAME_WORK 200000       // loop iterations of one simulated frame (rendering / LCD transfer)
+#define PINNED_PIPELINE 1       // 0: audio tasks without core affinity
+
+uint8_t * fx;
+
+void printResult(Scenario & sc, SoundProfile & p);
+
+// nothing is playing, so the timer is stopped: measure the renderer directly
+void runIdle(Scenario & sc) {
+    SoundProfile p;
+    memset(&p, 0, sizeof(p));
+    p.outputMinCycles = 0xffffffff;
+    for (uint16_t i=0; i<10000; i++) {
+        uint8_t sample;
+        uint32_t c = ESP.getCycleCount();
+        ESP32Sound.renderBlock(&sample, 1);
+        c = ESP.getCycleCount() - c;
+        p.outputCalls++;
+        p.outputTotalCycles += c;
+        p.outputHistogram[c/PROFILE_BUCKET_CYCLES < PROFILE_BUCKETS ? c/PROFILE_BUCKET_CYCLES : PROFILE_BUCKETS-1]++;
+        if (c < p.outputMinCycles) p.outputMinCycles = c;
+        if (c > p.outputMaxCycles) p.outputMaxCycles = c;
+    }
+    printResult(sc, p);
+}
+
+void runScenario(Scenario & sc) {
+    fxHandle_t voices[FX_VOICES];
+    for (uint8_t i=0; i<FX_VOICES; i++) voices[i]=FX_NO_VOICE;
+
+    ESP32Sound.setProfiling(true);
+    if (sc.file) ESP32Sound.playSound(SD, sc.file);
+    unsigned long start = millis();
+    while (millis() - start < SCENARIO_TIME) {
+        // keep the FX voices busy
+        for (uint8_t i=0; i<sc.fxVoices; i++)
+            if (!ESP32Sound.isFxPlaying(voices[i])) voices[i]=ESP32Sound.playFx(fx);
+        delay(10);
+    }
+    SoundProfile p = ESP32Sound.getProfile();
+    ESP32Sound.setProfiling(false);
+    ESP32Sound.stopSound();
+    ESP32Sound.stopAllFx();
+
+    printResult(sc, p);
+    delay(500);   // let the output run out
+}
+
+void printResult(Scenario & sc, SoundProfile & p) {
+    if (!p.outputCalls) return;
+    Serial.printf("CSV,%s,%u,%u,%u,%u,%u,%u,%u\n", sc.name, p.outputCalls, p.outputMinCycles,
+                  (uint32_t)(p.outputTotalCycles / p.outputCalls), percentile(p, 99), p.outputMaxCycles,
+                  bytesPerKcycle(p.streamBytes, p.streamCycles), bytesPerKcycle(p.readBytes, p.readCycles));
+}
+
+// a busy loop() without delays: the frame time grows if audio tasks run on the same core
+void runFrames(const char * name, const char * file, uint8_t fxVoices) {
+    fxHandle_t voices[FX_VOICES];
+    for (uint8_t i=0; i<FX_VOICES; i++) voices[i]=FX_NO_VOICE;
+    volatile uint32_t work=0;
+    uint32_t frames=0, maxUs=0;
+
+    if (file) ESP32Sound.playSound(SD, file);
+    uint32_t underruns = ESP32Sound.getStats().underruns;
+    unsigned long start = millis();
+    while (millis() - start < SCENARIO_TIME) {
+        uint32_t t = micros();
+        for (uint32_t i=0; i<FRAME_WORK; i++) work+=i;
+        for (uint8_t i=0; i<fxVoices; i++)
+            if (!ESP32Sound.isFxPlaying(voices[i])) voices[i]=ESP32Sound.playFx(fx);
+        t = micros() - t;
+        if (t > maxUs) maxUs=t;
+        frames++;
+    }
+    underruns = ESP32Sound.getStats().underruns - underruns;
+    ESP32Sound.stopSound();
+    ESP32Sound.stopAllFx();
+
+    Serial.printf("CSV,%s,%d,%u,%u,%u\n", name, PINNED_PIPELINE, frames*1000/SCENARIO_TIME, maxUs, underruns);
+    delay(500);
+}
+
+void setup(){
+    Serial.begin(115200);
+    Serial.println("Now initialising SD card!");
+    if(!SD.begin()){
+        Serial.println("Card Mount Failed");
+        return;
+    }
+
+    Serial.println("Creating test files ...");
+    for (uint8_t i=0; i<SCENARIOS; i++)
+        if (scenarios[i].file) createTestFile(SD, scenarios[i].file, scenarios[i].bits, scenarios[i].channels);
+    fx = createTestFx();
+
+    Serial.println("Now initialising sound system!");
+    if (!PINNED_PIPELINE) {
+        SoundPipeline p = ESP32Sound.getPipeline();
+        p.ioCore = p.outputCore = SOUND_ANY_CORE;
+        ESP32Sound.setPipeline(p);
+    }
+    ESP32Sound.begin(PLAYBACK_RATE);
+    ESP32Sound.setVerbosity(0);
+}
+
+void loop(){
+    Serial.printf(SCENARIO_CSV_HEADER);
+    for (uint8_t i=0; i<SCENARIOS; i++) {
+        if (!scenarios[i].fxVoices && !scenarios[i].file) runIdle(scenarios[i]);
+        else runScenario(scenarios[i]);
+    }
+    Serial.printf("CSV,frame_scenario,pinned,frames_per_s,max_frame_us,underruns\n");
+    runFrames("frames_silent", NULL, 0);
+    runFrames("frames_stream_16_stereo", "/bench_16s.wav", 0);
+    runFrames("frames_fx4_stream_16_stereo", "/bench_16s.wav", 4);
+    delay(10000);
+}
@@ -0,0 +1,105 @@
+//
+// scenarios.h - the scenarios of the benchmark sketch and their test files
+// https://github.com/ChrisVeigl/ESP32Sound
+//
+// Also used by the host benchmark tests/bench_scenarios.cpp, so that both measure the same
+// scenarios with the same files (results are printed in the same CSV columns).
+//
+
+#ifndef _scenarios_H_
+#define _scenarios_H_
+
+#include <FS.h>
+#include "ESP32Sound.h"
+
+#define PLAYBACK_RATE  16000
+#define SCENARIO_TIME  3000     // duration of one scenario in milliseconds
+#define TESTFILE_SECONDS 4      // length of the generated test files
+#define FX_SAMPLES 8000
+
+struct Scenario {
+    const char * name;
+    uint8_t fxVoices;           // number of concurrent FX
+    const char * file;          // music file, or NULL
+    uint16_t bits;              // format of the music file
+    uint16_t channels;
+};
+
+static Scenario scenarios[] = {
+    { "idle",             0, NULL,             0,  0 },
+    { "fx1",              1, NULL,             0,  0 },
+    { "fx4",              4, NULL,             0,  0 },
+    { "stream_8_mono",    0, "/bench_8m.wav",  8,  1 },
+    { "stream_8_stereo",  0, "/bench_8s.wav",  8,  2 },
+    { "stream_16_mono",   0, "/bench_16m.wav", 16, 1 },
+    { "stream_16_stereo", 0, "/bench_16s.wav", 16, 2 },
+    { "fx1_stream_8_mono",   1, "/bench_8m.wav",  8,  1 },
+    { "fx4_stream_16_stereo",4, "/bench_16s.wav", 16, 2 },
+};
+
+#define SCENARIOS (sizeof(scenarios)/sizeof(Scenario))
+
+// the columns of the scenario results: the throughput is given per 1000 cycles, as the host counts
+// time stamp counter ticks instead of CPU cycles (the rate per second is this * MHz)
+#define SCENARIO_CSV_HEADER "CSV,scenario,calls,min_cycles,mean_cycles,p99_cycles,max_cycles,stream_bytes_per_kcycle,sd_bytes_per_kcycle\n"
+
+// writes a sine sweep in the given format
+static void createTestFile(fs::FS & fs, const char * path, uint16_t bits, uint16_t channels) {
+    if (fs.exists(path)) return;
+    File f = fs.open(path, FILE_WRITE);
+    if (!f) return;
+    uint32_t frames = PLAYBACK_RATE * TESTFILE_SECONDS;
+    uint32_t dataSize = frames * channels * (bits/8);
+    uint8_t header[44];
+    memcpy(header, "RIFF", 4);
+    uint32_t v = dataSize + 36;            memcpy(header+4, &v, 4);
+    memcpy(header+8, "WAVEfmt ", 8);
+    v = 16;                                memcpy(header+16, &v, 4);
+    uint16_t s = 1;                        memcpy(header+20, &s, 2);
+    memcpy(header+22, &channels, 2);
+    v = PLAYBACK_RATE;                     memcpy(header+24, &v, 4);
+    v = PLAYBACK_RATE*channels*(bits/8);   memcpy(header+28, &v, 4);
+    s = channels*(bits/8);                 memcpy(header+32, &s, 2);
+    memcpy(header+34, &bits, 2);
+    memcpy(header+36, "data", 4);
+    memcpy(header+40, &dataSize, 4);
+    f.write(header, 44);
+
+    uint8_t buf[512];
+    uint16_t n=0;
+    for (uint32_t i=0; i<frames; i++) {
+        int16_t val = 12000 * sin(2*PI*(200+i/20)*i/PLAYBACK_RATE);
+        for (uint16_t c=0; c<channels; c++) {
+            if (bits==8) buf[n++] = (val>>8) + 128;
+            else { buf[n++] = val & 0xff; buf[n++] = val >> 8; }
+        }
+        if (n >= sizeof(buf)-4) { f.write(buf, n); n=0; }
+    }
+    f.write(buf, n);
+    f.close();
+}
+
+// the test FX (4 bytes length + 8-bit samples), allocated with malloc()
+static uint8_t * createTestFx() {
+    uint8_t * fx = (uint8_t *) malloc(FX_SAMPLES + 4);
+    uint32_t len = FX_SAMPLES;
+    memcpy(fx, &len, 4);
+    for (uint32_t i=0; i<FX_SAMPLES; i++) fx[i+4] = 128 + 100 * sin(2*PI*440*i/PLAYBACK_RATE);
+    return (fx);
+}
+
+// cycles below which the given percentage of all output calls finished
+static uint32_t bytesPerKcycle(uint32_t bytes, uint64_t cycles) {
+    return (cycles ? (uint32_t)((uint64_t)bytes * 1000 / cycles) : 0);
+}
+
+static uint32_t percentile(SoundProfile & p, uint8_t percent) {
+    uint64_t limit = (uint64_t)p.outputCalls * percent / 100, sum=0;
+    for (uint8_t i=0; i<PROFILE_BUCKETS; i++) {
+        sum += p.outputHistogram[i];
+        if (sum >= limit) return ((i+1)*PROFILE_BUCKET_CYCLES);
+    }
+    return (p.outputMaxCycles);
+}
+
+#endif
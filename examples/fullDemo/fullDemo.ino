@@ -72,8 +72,10 @@ void loop(){
       if (GO.JOY_X.isAxisPressed() == 2)   ESP32Sound.playFx(fx3);
       if (GO.JOY_X.isAxisPressed() == 1)   ESP32Sound.playFx(fx4);
       if (GO.BtnB.isPressed())   ESP32Sound.stopSound();
-      if (GO.BtnA.isPressed() && soundfileCount)  
-          ESP32Sound.playSound(SD, soundfileNames[actSoundfile]);
+      if (GO.BtnA.isPressed() && soundfileCount) {
+          if (ESP32Sound.isPlaying()) ESP32Sound.crossfadeTo(SD, soundfileNames[actSoundfile], 1000);
+          else ESP32Sound.playSound(SD, soundfileNames[actSoundfile]);
+      }
       if (GO.BtnMenu.isPressed()) { 
           actFxVolume+=10; 
           if (actFxVolume>150) actFxVolume=0; 
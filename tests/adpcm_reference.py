@@ -0,0 +1,38 @@
+#
+#  writes an IMA-ADPCM .wav file with convertTool/adpcm.py and the samples decoded 
+#  by the script (16-bit raw), for test_adpcm
+#  usage: python3 adpcm_reference.py <outdir>
+#
+
+import math
+import os
+import struct
+import sys
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'convertTool'))
+import adpcm
+
+outdir = sys.argv[1]
+samples = [int(12000 * math.sin(2 * math.pi * 440 * i / 16000.0) + 3000 * math.sin(i * 0.37)) for i in range(20000)]
+for blockAlign in (256, 512):
+    wavName = os.path.join(outdir, 'adpcm_%d.wav' % blockAlign)
+    adpcm.write_wav(wavName, samples, 16000, blockAlign)
+    data = adpcm.encode_blocks(samples, blockAlign)
+    decoded = []
+    for b in range(0, len(data), blockAlign):
+        predictor, index = struct.unpack('<hB', data[b:b + 3])
+        decoded.append(predictor)
+        for byte in bytearray(data[b + 4:b + blockAlign]):
+            for nibble in (byte & 0x0f, byte >> 4):
+                predictor, index = adpcm.decode_nibble(nibble, predictor, index)
+                decoded.append(predictor)
+    with open(os.path.join(outdir, 'adpcm_%d.raw' % blockAlign), 'wb') as f:
+        f.write(struct.pack('<%dh' % len(decoded), *decoded))
+
+# a compressed FX array (wav2array.py / wav2bank.py) and its 8-bit source samples, for the round trip test
+fx = [128 + int(round(90 * math.sin(2 * math.pi * 440 * i / 16000.0) + 20 * math.sin(2 * math.pi * 3000 * i / 16000.0)))
+      for i in range(8001)]
+with open(os.path.join(outdir, 'fx_adpcm.bin'), 'wb') as f:
+    f.write(adpcm.encode_fx(fx))
+with open(os.path.join(outdir, 'fx_pcm8.raw'), 'wb') as f:
+    f.write(bytearray(fx))
@@ -0,0 +1,38 @@
+#
+#  writes two 8-bit .wav files and FX bank images of them with convertTool/wav2bank.py
+#  (bank_pcm.bin and bank_adpcm.bin), for test_bank
+#  usage: python3 bank_reference.py <outdir>
+#
+
+import math
+import os
+import shutil
+import subprocess
+import sys
+import wave
+
+outdir = os.path.abspath(sys.argv[1])
+tool = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'convertTool', 'wav2bank.py')
+
+# 16kHz mono 8-bit: wav2bank.py stores these samples unchanged
+sounds = {
+    'tone': [128 + int(round(100 * math.sin(2 * math.pi * 440 * i / 16000.0))) for i in range(3001)],
+    'chirp': [128 + int(round(60 * math.sin(2 * math.pi * (200 + i / 4.0) * i / 16000.0))) for i in range(1000)],
+}
+files = []
+for name in ('tone', 'chirp'):
+    path = os.path.join(outdir, name + '.wav')
+    w = wave.open(path, 'wb')
+    w.setnchannels(1)
+    w.setsampwidth(1)
+    w.setframerate(16000)
+    w.writeframes(bytearray(sounds[name]))
+    w.close()
+    files.append(path)
+
+for kind, options in (('pcm', []), ('adpcm', ['--adpcm'])):
+    workdir = os.path.join(outdir, 'bank_' + kind)
+    if not os.path.isdir(workdir):
+        os.makedirs(workdir)
+    subprocess.check_call([sys.executable, tool] + options + files, cwd=workdir)
+    shutil.copy(os.path.join(workdir, 'sounds.bin'), os.path.join(outdir, 'bank_' + kind + '.bin'))
@@ -0,0 +1,97 @@
+//
+//  bench_convert - throughput of the PCM conversion kernels (SoundConvert)
+//  part of the ESP32Sound library, https://github.com/ChrisVeigl/ESP32Sound
+//
+//  Converts the data of the bundled examples/*/data/*.wav files with the kernel for 
+//  their layout, and with a per-sample loop (a branch on bits and channels for 
+//  every sample) for comparison. The data is also converted with all other layouts, 
+//  interpreted as 8/16 bit mono/stereo frames.
+//
+//  This code is released under GPLv3 license.
+//  see: https://www.gnu.org/licenses/gpl-3.0.en.html and https://www.fsf.org/
+
+#include <dirent.h>
+#include <string>
+#include "check.h"
+#include "wavfile.h"
+#include "SoundConvert.h"
+
+#define CHUNK_FRAMES 512     // same as DEFAULT_CHUNK_SIZE
+#define MIN_BYTES 50000000   // converted bytes per measurement
+
+// a per-sample loop like the one of the original stream task (a branch on bits and channels 
+// for every sample), with the output format of the kernels, for comparison
+static uint32_t perSample(const uint8_t * in, int16_t * out, uint32_t bytes, uint16_t bits, uint16_t channels) {
+    uint32_t n=0;
+    for (uint32_t i=0; i<bytes; ) {
+        int16_t val;
+        if (bits==8) val=(in[i++]-128)*256;
+        else { val=(int16_t)(in[i] | (in[i+1]<<8)); i+=2; }
+        if (channels==2) i+=bits/8;
+        out[n++]=val;
+    }
+    return(n);
+}
+
+static void bench(const char * name, const std::vector<uint8_t> & data, uint16_t bits, uint16_t channels) {
+    uint32_t frameBytes = bits/8*channels;
+    uint32_t frames = data.size()/frameBytes;
+    if (!frames) return;
+    static int16_t out[CHUNK_FRAMES];
+    soundConvertFunc f = getSoundConverter(bits, channels);
+    uint32_t rounds = MIN_BYTES/(frames*frameBytes)+1;
+
+    uint64_t t = benchTime();
+    for (uint32_t r=0; r<rounds; r++)
+        for (uint32_t i=0; i<frames; i+=CHUNK_FRAMES) {
+            uint32_t n = frames-i < CHUNK_FRAMES ? frames-i : CHUNK_FRAMES;
+            f(&data[i*frameBytes], out, n);
+            benchEscape(out);
+        }
+    t = benchTime()-t;
+    uint64_t t0 = benchTime();
+    for (uint32_t r=0; r<rounds; r++)
+        for (uint32_t i=0; i<frames; i+=CHUNK_FRAMES) {
+            uint32_t n = frames-i < CHUNK_FRAMES ? frames-i : CHUNK_FRAMES;
+            perSample(&data[i*frameBytes], out, n*frameBytes, bits, channels);
+            benchEscape(out);
+        }
+    t0 = benchTime()-t0;
+    double msamples = (double)frames*rounds*1000/t, msamples0 = (double)frames*rounds*1000/t0;
+    printf("CSV,%s,%u,%u,%.1f,%.1f,%.2f\n", name, bits, channels, msamples, msamples0, msamples/msamples0);
+}
+
+int main() {
+    printf("CSV,file,bits,channels,kernel_msamples_per_s,per_sample_msamples_per_s,speedup\n");
+    const char * base = "../examples";
+    DIR * d = opendir(base);
+    CHECK(d != NULL);
+    if (!d) return (checkResult("bench_convert"));
+    uint8_t files=0;
+    struct dirent * e;
+    while ((e = readdir(d)) != NULL) {
+        if (e->d_name[0]=='.') continue;
+        std::string dir = std::string(base) + "/" + e->d_name + "/data";
+        DIR * dd = opendir(dir.c_str());
+        if (!dd) continue;
+        struct dirent * f;
+        while ((f = readdir(dd)) != NULL) {
+            std::string name = f->d_name;
+            if ((name.size() < 4) || (name.substr(name.size()-4) != ".wav")) continue;
+            WavFile w;
+            if (!loadWav((dir + "/" + name).c_str(), w) || (w.format != 1)) continue;
+            files++;
+            bench(name.c_str(), w.data, w.bits, w.channels);
+            // the same data as the other layouts
+            uint16_t layouts[4][2] = { {8,1}, {8,2}, {16,1}, {16,2} };
+            for (uint8_t l=0; l<4; l++) {
+                if ((layouts[l][0]==w.bits) && (layouts[l][1]==w.channels)) continue;
+                bench((name + "_as_layout").c_str(), w.data, layouts[l][0], layouts[l][1]);
+            }
+        }
+        closedir(dd);
+    }
+    closedir(d);
+    CHECK(files > 0);
+    return (files ? 0 : checkResult("bench_convert"));
+}
@@ -0,0 +1,42 @@
+//
+//  bench_dither - cost of the quantization to the DAC (SOUND_DITHER) per output sample
+//  part of the ESP32Sound library, https://github.com/ChrisVeigl/ESP32Sound
+//
+//  Built once for each dither mode. The renderer is called directly in blocks of 128 samples,
+//  idle (only the quantizer) and with one FX; the difference to the mode "none" is the cost
+//  of the dither. Cycles are time stamp counter ticks of the host, not ESP32 cycles.
+//
+//  This code is released under GPLv3 license.
+//  see: https://www.gnu.org/licenses/gpl-3.0.en.html and https://www.fsf.org/
+
+#include "engine.h"
+#include "SoundPlatform.h"
+
+#define BENCH_SAMPLES (1<<16)
+#define BLOCK 128
+
+static const char * modes[] = { "none", "tpdf", "noiseshape" };
+
+static void bench(const std::vector<uint8_t> & fx, uint8_t voices) {
+    static uint8_t out[BLOCK];
+    ESP32Sound.stopAllFx();
+    if (voices) ESP32Sound.playFx(&fx[0], 50);
+    uint64_t t = benchTime();
+    uint32_t c = soundCycleCount();
+    for (uint32_t n=0; n<BENCH_SAMPLES; n+=BLOCK) ESP32Sound.renderBlock(out, BLOCK);
+    c = soundCycleCount()-c;
+    t = benchTime()-t;
+    benchEscape(out);
+    printf("CSV,%s,%d,%.2f,%.1f\n", modes[SOUND_DITHER], voices, (double)t/BENCH_SAMPLES, (double)c/BENCH_SAMPLES);
+}
+
+int main() {
+    std::vector<uint8_t> pcm = makeFx(BENCH_SAMPLES*2, 440, 0.5);
+
+    ESP32Sound.setVerbosity(0);
+    ESP32Sound.begin(16000);
+    printf("CSV,dither,voices,ns_per_sample,cycles_per_sample\n");
+    bench(pcm, 0);
+    bench(pcm, 1);
+    return (0);
+}
@@ -0,0 +1,72 @@
+//
+//  bench_gain - volume scaling in the mixer: Q8 gains against divides by the volumes in %
+//  part of the ESP32Sound library, https://github.com/ChrisVeigl/ESP32Sound
+//
+//  The engine renders 4 FX voices (at 100, 80, 50 and 30%) and pushed samples (at the music
+//  volume) with renderBlock() in blocks of 128 samples, like the I2S output task. Built twice:
+//  with the Q8 gains and with SOUND_GAIN_DIVIDE=1 (the former mixer), both without dither.
+//  The output is compared with the exact mix (rounded to a DAC step): the Q8 gains are rounded
+//  to 1/256 and the shifts round down, the divides round towards zero. On the 16-bit bus these
+//  errors are below one DAC step, so each path is off by at most 1 step (the two paths differ
+//  by up to 2 steps, they are not bit-exact).
+//  Cycles are time stamp counter ticks of the host, not ESP32 cycles.
+//
+//  This code is released under GPLv3 license.
+//  see: https://www.gnu.org/licenses/gpl-3.0.en.html and https://www.fsf.org/
+
+#include "engine.h"
+#include "SoundPlatform.h"
+
+#define BENCH_SAMPLES (1<<16)
+#define BLOCK 128
+#define VOICES 4
+#define FX_VOLUME 50
+#define SOUND_VOLUME 30
+
+static const uint8_t voiceVolume[VOICES] = { 100, 80, 50, 30 };
+
+int main() {
+    std::vector<std::vector<uint8_t>> fx(VOICES, std::vector<uint8_t>(BENCH_SAMPLES+4));
+    std::vector<int16_t> pushed(BENCH_SAMPLES);
+    std::vector<uint8_t> out(BENCH_SAMPLES);
+    uint32_t seed=1;
+    for (auto & f : fx) {
+        wavPut32(&f[0], BENCH_SAMPLES);
+        for (uint32_t i=4; i<f.size(); i++) { seed = seed*1103515245+12345; f[i] = seed>>24; }
+    }
+    for (auto & s : pushed) { seed = seed*1103515245+12345; s = (int16_t)(seed>>16); }
+
+    ESP32Sound.setVerbosity(0);
+    ESP32Sound.begin(16000);
+    ESP32Sound.setFxVolume(FX_VOLUME);
+    ESP32Sound.setSoundVolume(SOUND_VOLUME);
+    hostRun(0);             // the stream task applies the volumes
+    for (uint8_t v=0; v<VOICES; v++) CHECK(ESP32Sound.playFx(&fx[v][0], voiceVolume[v]) != FX_NO_VOICE);
+
+    uint64_t t = 0;
+    uint32_t c = 0;
+    for (uint32_t n=0; n<BENCH_SAMPLES; n+=BLOCK) {
+        CHECK_EQ(ESP32Sound.pushSamples(&pushed[n], BLOCK), BLOCK);
+        uint64_t t0 = benchTime();
+        uint32_t c0 = soundCycleCount();
+        ESP32Sound.renderBlock(&out[n], BLOCK);
+        c += soundCycleCount()-c0;
+        t += benchTime()-t0;
+    }
+    benchEscape(&out[0]);
+
+    int maxDiff = 0;
+    for (uint32_t i=0; i<BENCH_SAMPLES; i++) {
+        double fxMix = 0;
+        for (uint8_t v=0; v<VOICES; v++) fxMix += (fx[v][i+4]-128) * voiceVolume[v] / 100.0;
+        double exact = 127 + fxMix*FX_VOLUME/100 + pushed[i]/256.0*SOUND_VOLUME/100;
+        exact = exact < 0 ? 0 : (exact > 255 ? 255 : exact);    // the bus saturates
+        int diff = abs(out[i] - (int)lround(exact));
+        if (diff > maxDiff) maxDiff = diff;
+    }
+    printf("CSV,path,ns_per_sample,cycles_per_sample,max_error_steps\n");
+    printf("CSV,%s,%.2f,%.1f,%d\n", SOUND_GAIN_DIVIDE ? "divide" : "q8_gain",
+           (double)t/BENCH_SAMPLES, (double)c/BENCH_SAMPLES, maxDiff);
+    CHECK(maxDiff <= 1);
+    return (checkResult("bench_gain"));
+}
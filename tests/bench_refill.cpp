@@ -0,0 +1,86 @@
+//
+//  bench_refill - context switches and underruns of the stream pipeline over sample buffer size and refill watermarks
+//  part of the ESP32Sound library, https://github.com/ChrisVeigl/ESP32Sound
+//
+//  A 44.1kHz 16-bit stereo file is played for 10 seconds of virtual time on the host simulation
+//  with each sample buffer size and low watermark (setRefillWatermarks(), high watermark 100%),
+//  while the SD card stalls: every read takes 2ms, every 4th read another 40ms.
+//  Built twice: bench_refill wakes the stream task at the low watermark (task notification from
+//  the output), bench_refill_poll is the former behaviour (SOUND_REFILL_POLL: a full sample buffer is 
+//  checked every WAIT_FOR_QUEUESPACE ticks, the watermarks are not used).
+//  Reported per second: wake-ups of the stream task (sst1) and of the reader task (srt1), the
+//  wake-ups by the output (refillWakeups), and the underruns (output samples without data).
+//  The last lines give the smallest buffer without underruns for each watermark.
+//  The files start with full buffers (paused while the buffers are filled), so that only the
+//  steady state is measured (see test_sd_stalls for the start).
+//
+//  This code is released under GPLv3 license.
+//  see: https://www.gnu.org/licenses/gpl-3.0.en.html and https://www.fsf.org/
+
+#include <unistd.h>
+#include "engine.h"
+
+#define RATE 16000
+#define SECONDS 10
+
+#if SOUND_REFILL_POLL
+static const char * mode = "poll";
+static uint8_t lows[] = { 50 };       // not used
+#else
+static const char * mode = "notify";
+static uint8_t lows[] = { 25, 50, 75 };
+#endif
+static uint16_t sizes[] = { 8192, 4096, 2048, 1024, 512, 256, 128 };     // the smallest buffer without underruns is searched
+
+// returns the underruns
+static uint32_t bench(fs::FS & sd, uint16_t bufsize, uint8_t low) {
+    ESP32Sound.begin(RATE, bufsize);
+    ESP32Sound.setRefillWatermarks(low, 100);
+    ESP32Sound.pause();
+    CHECK(ESP32Sound.playSound(sd, "/music.wav") != SOUND_NO_HANDLE);
+    hostRun(RATE/2);
+    ESP32Sound.resetStats();
+    uint32_t stream = hostTaskWakeups("sst1"), reader = hostTaskWakeups("srt1");
+    ESP32Sound.resume();
+    hostRun(RATE*SECONDS);
+    SoundStats st = ESP32Sound.getStats();
+    stream = hostTaskWakeups("sst1") - stream;
+    reader = hostTaskWakeups("srt1") - reader;
+    printf("CSV,%s,%u,%u,%.1f,%.1f,%.1f,%u\n", mode, bufsize, SOUND_REFILL_POLL ? 0 : low,
+           (double)stream/SECONDS, (double)reader/SECONDS, (double)st.refillWakeups/SECONDS, st.underruns);
+    CHECK(SOUND_REFILL_POLL ? (st.refillWakeups == 0) : (st.refillWakeups > 0));
+    ESP32Sound.stopSound();
+    hostRun(0);
+    return (st.underruns);
+}
+
+int main() {
+    std::string dir = tempDir();
+    CHECK(writeTestWav(dir + "/music.wav", 44100, 2, 44100*(SECONDS+2), [](uint32_t i, uint16_t c) {
+        return ((int16_t) lround(8000*sin(2*M_PI*(c ? 330 : 220)*i/44100)));
+    }));
+    fs::FS sd(dir.c_str());
+    sd.setLatency(2000, 4, 40000);
+    const uint8_t nSizes = sizeof(sizes)/sizeof(sizes[0]);
+    uint16_t smallest[sizeof(lows)];
+
+    ESP32Sound.setVerbosity(0);
+    printf("CSV,refill,bufsize,low_percent,stream_wakeups_per_s,reader_wakeups_per_s,refill_wakeups_per_s,underruns\n");
+    for (uint8_t k=0; k<sizeof(lows); k++) {
+        smallest[k] = 0;
+        for (uint8_t i=0; i<nSizes; i++) {
+            if (bench(sd, sizes[i], lows[k])) break;
+            smallest[k] = sizes[i];
+        }
+    }
+    for (uint8_t k=0; k<sizeof(lows); k++) {
+        if (SOUND_REFILL_POLL) printf("poll: ");
+        else printf("notify, low watermark %u%%: ", lows[k]);
+        printf("smallest buffer without underruns %u samples\n", smallest[k]);
+    }
+
+    sd.setLatency(0);
+    sd.remove("/music.wav");
+    rmdir(dir.c_str());
+    return (checkResult(SOUND_REFILL_POLL ? "bench_refill_poll" : "bench_refill"));
+}
@@ -0,0 +1,42 @@
+//
+//  bench_resampler - throughput of the streaming sample rate converter (SoundResampler)
+//  part of the ESP32Sound library, https://github.com/ChrisVeigl/ESP32Sound
+//
+//  Converts noise from common file rates to 16 kHz in chunks of 512 input samples 
+//  (like the stream task), for both quality levels.
+//
+//  This code is released under GPLv3 license.
+//  see: https://www.gnu.org/licenses/gpl-3.0.en.html and https://www.fsf.org/
+
+#include <stdlib.h>
+#include "check.h"
+#include "SoundResampler.h"
+
+#define OUT_RATE 16000
+#define CHUNK 512
+#define BENCH_INPUT 20000000     // input samples per measurement
+
+int main() {
+    static int16_t in[CHUNK], out[CHUNK*8];
+    for (uint32_t i=0; i<CHUNK; i++) in[i]=rand();
+    uint32_t rates[] = { 8000, 22050, 32000, 44100, 48000 };
+    const char * names[] = { "linear", "fir" };
+
+    printf("CSV,quality,in_rate,out_rate,in_msamples_per_s,out_msamples_per_s\n");
+    for (uint8_t q=RESAMPLE_LINEAR; q<=RESAMPLE_FIR; q++) {
+        for (uint8_t i=0; i<5; i++) {
+            SoundResampler r;
+            r.setup(rates[i], OUT_RATE, q);
+            uint64_t produced=0;
+            uint64_t t = benchTime();
+            for (uint32_t done=0; done<BENCH_INPUT; done+=CHUNK) {
+                uint32_t consumed;
+                produced += r.process(in, CHUNK, consumed, out, sizeof(out)/2);
+                benchEscape(out);
+            }
+            t = benchTime()-t;
+            printf("CSV,%s,%u,%u,%.1f,%.1f\n", names[q], rates[i], OUT_RATE, BENCH_INPUT*1000.0/t, produced*1000.0/t);
+        }
+    }
+    return (0);
+}
@@ -0,0 +1,67 @@
+//
+//  bench_ring - throughput of the lock-free ring buffer (SoundRing.h)
+//  part of the ESP32Sound library, https://github.com/ChrisVeigl/ESP32Sound
+//
+//  The producer writes chunks (like the stream task), the consumer reads one sample 
+//  at a time (like the timer ISR), in the same thread and in two threads.
+//
+//  This code is released under GPLv3 license.
+//  see: https://www.gnu.org/licenses/gpl-3.0.en.html and https://www.fsf.org/
+
+#include <thread>
+#include "check.h"
+#include "SoundRing.h"
+
+#define BENCH_SAMPLES 20000000
+#define RING_SIZE 4096
+
+static void benchSingleThread(uint32_t chunk) {
+    SoundRing<int16_t> r;
+    r.allocate(RING_SIZE);
+    int16_t buf[512], v=0;
+    for (uint32_t i=0; i<chunk; i++) buf[i]=i;
+    uint32_t sum=0;
+    uint64_t t = benchTime();
+    for (uint32_t done=0; done < BENCH_SAMPLES; done+=chunk) {
+        r.write(buf, chunk);
+        while (r.read(v)) sum+=v;
+    }
+    t = benchTime()-t;
+    benchSink=sum;
+    printf("CSV,ring_single_thread,%u,%.1f,%.2f\n", chunk, BENCH_SAMPLES*1000.0/t, (double)t/BENCH_SAMPLES);
+}
+
+static void benchTwoThreads(uint32_t chunk) {
+    SoundRing<int16_t> r;
+    r.allocate(RING_SIZE);
+    uint64_t t = benchTime();
+    std::thread consumer([&]() {
+        uint32_t got=0, sum=0;
+        int16_t v=0;
+        while (got < BENCH_SAMPLES) {
+            if (r.read(v)) { sum+=v; got++; }
+            else std::this_thread::yield();
+        }
+        benchSink=sum;
+    });
+    int16_t buf[512];
+    for (uint32_t i=0; i<chunk; i++) buf[i]=i;
+    uint32_t done=0;
+    while (done < BENCH_SAMPLES) {
+        uint32_t n = BENCH_SAMPLES-done < chunk ? BENCH_SAMPLES-done : chunk;
+        uint32_t w = r.write(buf, n);
+        if (!w) std::this_thread::yield();
+        done+=w;
+    }
+    consumer.join();
+    t = benchTime()-t;
+    printf("CSV,ring_two_threads,%u,%.1f,%.2f\n", chunk, BENCH_SAMPLES*1000.0/t, (double)t/BENCH_SAMPLES);
+}
+
+int main() {
+    printf("CSV,benchmark,chunk,msamples_per_s,ns_per_sample\n");
+    uint32_t chunks[] = { 1, 64, 512 };
+    for (uint8_t i=0; i<3; i++) benchSingleThread(chunks[i]);
+    for (uint8_t i=0; i<3; i++) benchTwoThreads(chunks[i]);
+    return (0);
+}
@@ -0,0 +1,87 @@
+//
+//  bench_scenarios - the scenarios of examples/benchmark on the host simulation
+//  part of the ESP32Sound library, https://github.com/ChrisVeigl/ESP32Sound
+//
+//  The scenario table and the test files are the same as in the benchmark sketch
+//  (examples/benchmark/scenarios.h), the CSV columns are the same, so that the host and
+//  the ESP32 results can be compared. Each scenario runs SCENARIO_TIME of simulated time.
+//  Cycles are time stamp counter ticks of the host, not ESP32 cycles: the byte rates are
+//  given per 1000 cycles on both.
+//
+//  This code is released under GPLv3 license.
+//  see: https://www.gnu.org/licenses/gpl-3.0.en.html and https://www.fsf.org/
+
+#include <unistd.h>
+#include "engine.h"
+#include "SoundPlatform.h"
+#include "scenarios.h"
+
+static uint8_t * fx;
+
+static void printResult(Scenario & sc, SoundProfile & p) {
+    if (!p.outputCalls) return;
+    printf("CSV,%s,%u,%u,%u,%u,%u,%u,%u\n", sc.name, p.outputCalls, p.outputMinCycles,
+           (uint32_t)(p.outputTotalCycles / p.outputCalls), percentile(p, 99), p.outputMaxCycles,
+           bytesPerKcycle(p.streamBytes, p.streamCycles), bytesPerKcycle(p.readBytes, p.readCycles));
+}
+
+// like runScenario() of the sketch: the FX voices are kept busy, checked every 10ms
+static void runScenario(fs::FS & sd, Scenario & sc) {
+    fxHandle_t voices[FX_VOICES];
+    for (uint8_t i=0; i<FX_VOICES; i++) voices[i]=FX_NO_VOICE;
+
+    ESP32Sound.setProfiling(true);
+    if (sc.file) CHECK(ESP32Sound.playSound(sd, sc.file) != SOUND_NO_HANDLE);
+    for (uint32_t t=0; t<SCENARIO_TIME; t+=10) {
+        for (uint8_t i=0; i<sc.fxVoices; i++)
+            if (!ESP32Sound.isFxPlaying(voices[i])) voices[i]=ESP32Sound.playFx(fx);
+        hostRun(PLAYBACK_RATE/100);
+    }
+    SoundProfile p = ESP32Sound.getProfile();
+    ESP32Sound.setProfiling(false);
+    ESP32Sound.stopSound();
+    ESP32Sound.stopAllFx();
+    hostRun(PLAYBACK_RATE/2);   // let the output run out
+    printResult(sc, p);
+}
+
+// nothing is playing: the renderer is called directly, like runIdle() of the sketch
+static void runIdle(Scenario & sc) {
+    SoundProfile p;
+    memset(&p, 0, sizeof(p));
+    p.outputMinCycles = 0xffffffff;
+    for (uint16_t i=0; i<10000; i++) {
+        uint8_t sample;
+        uint32_t c = soundCycleCount();
+        ESP32Sound.renderBlock(&sample, 1);
+        c = soundCycleCount() - c;
+        p.outputCalls++;
+        p.outputTotalCycles += c;
+        p.outputHistogram[c/PROFILE_BUCKET_CYCLES < PROFILE_BUCKETS ? c/PROFILE_BUCKET_CYCLES : PROFILE_BUCKETS-1]++;
+        if (c < p.outputMinCycles) p.outputMinCycles = c;
+        if (c > p.outputMaxCycles) p.outputMaxCycles = c;
+    }
+    printResult(sc, p);
+}
+
+int main() {
+    std::string dir = tempDir();
+    fs::FS sd(dir.c_str());
+    for (uint8_t i=0; i<SCENARIOS; i++)
+        if (scenarios[i].file) createTestFile(sd, scenarios[i].file, scenarios[i].bits, scenarios[i].channels);
+    fx = createTestFx();
+
+    ESP32Sound.setVerbosity(0);
+    ESP32Sound.begin(PLAYBACK_RATE);
+    printf(SCENARIO_CSV_HEADER);
+    for (uint8_t i=0; i<SCENARIOS; i++) {
+        if (!scenarios[i].fxVoices && !scenarios[i].file) runIdle(scenarios[i]);
+        else runScenario(sd, scenarios[i]);
+    }
+    CHECK_EQ(ESP32Sound.getStats().underruns, 0);
+
+    for (uint8_t i=0; i<SCENARIOS; i++) if (scenarios[i].file) sd.remove(scenarios[i].file);
+    rmdir(dir.c_str());
+    free(fx);
+    return (checkResult("bench_scenarios"));
+}
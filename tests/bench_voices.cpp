@@ -0,0 +1,51 @@
+//
+//  bench_voices - cost of the mixer per output sample for 0 to FX_VOICES active FX voices
+//  part of the ESP32Sound library, https://github.com/ChrisVeigl/ESP32Sound
+//
+//  The renderer is called directly in blocks of 128 samples (like the I2S output task),
+//  with PCM and with IMA-ADPCM FX. Built with FX_VOICES=16.
+//  Cycles are time stamp counter ticks of the host, not ESP32 cycles.
+//
+//  This code is released under GPLv3 license.
+//  see: https://www.gnu.org/licenses/gpl-3.0.en.html and https://www.fsf.org/
+
+#include "engine.h"
+#include "SoundPlatform.h"
+
+#define BENCH_SAMPLES (1<<16)
+#define BLOCK 128
+
+// an ADPCM FX array: extended header, start predictor 0, step index 0, then nibbles
+static std::vector<uint8_t> adpcmFx(uint32_t samples) {
+    std::vector<uint8_t> fx(8 + (samples+1)/2);
+    fx[0]=samples; fx[1]=samples>>8; fx[2]=samples>>16;
+    fx[3]=FX_FLAG_EXTENDED | (FX_HEADER_VERSION<<4) | FX_FORMAT_ADPCM4;
+    for (uint32_t i=8; i<fx.size(); i++) fx[i] = (i & 1) ? 0x37 : 0xb2;
+    return (fx);
+}
+
+static void bench(const char * format, const std::vector<uint8_t> & fx, uint8_t voices) {
+    static uint8_t out[BLOCK];
+    ESP32Sound.stopAllFx();
+    for (uint8_t i=0; i<voices; i++) ESP32Sound.playFx(&fx[0], 100/voices+1);
+    uint64_t t = benchTime();
+    uint32_t c = soundCycleCount();
+    for (uint32_t n=0; n<BENCH_SAMPLES; n+=BLOCK) ESP32Sound.renderBlock(out, BLOCK);
+    c = soundCycleCount()-c;
+    t = benchTime()-t;
+    benchEscape(out);
+    printf("CSV,%s,%d,%.2f,%.1f\n", format, voices, (double)t/BENCH_SAMPLES, (double)c/BENCH_SAMPLES);
+}
+
+int main() {
+    std::vector<uint8_t> pcm = makeFx(BENCH_SAMPLES*2, 440, 0.5);
+    std::vector<uint8_t> adpcm = adpcmFx(BENCH_SAMPLES*2);
+    uint8_t counts[] = { 0, 1, 2, 4, 8, 16 };
+
+    ESP32Sound.setVerbosity(0);
+    ESP32Sound.begin(16000);
+    printf("CSV,format,voices,ns_per_sample,cycles_per_sample\n");
+    for (uint8_t i=0; i<sizeof(counts); i++) if (counts[i] <= FX_VOICES) bench("pcm8", pcm, counts[i]);
+    for (uint8_t i=0; i<sizeof(counts); i++) if (counts[i] <= FX_VOICES) bench("adpcm4", adpcm, counts[i]);
+    return (0);
+}
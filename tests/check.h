@@ -0,0 +1,43 @@
+//
+//  check.h - minimal test helpers for the host tests
+//  part of the ESP32Sound library, https://github.com/ChrisVeigl/ESP32Sound
+//
+//  CHECK() reports a failed condition and continues, main() returns checkResult().
+//  benchTime() is a monotonic clock in nanoseconds for the benchmarks.
+//
+//  This code is released under GPLv3 license.
+//  see: https://www.gnu.org/licenses/gpl-3.0.en.html and https://www.fsf.org/
+
+#ifndef _check_H_
+#define _check_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+static int checkFailures = 0;
+
+#define CHECK(cond) do { if (!(cond)) { \
+    printf("%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); checkFailures++; } } while (0)
+
+#define CHECK_EQ(a, b) do { long long _a=(long long)(a), _b=(long long)(b); if (_a != _b) { \
+    printf("%s:%d: CHECK failed: %s == %s (%lld != %lld)\n", __FILE__, __LINE__, #a, #b, _a, _b); \
+    checkFailures++; } } while (0)
+
+static inline int checkResult(const char * name) {
+    if (checkFailures) printf("%s: %d check(s) failed\n", name, checkFailures);
+    else printf("%s: passed\n", name);
+    return (checkFailures ? 1 : 0);
+}
+
+static inline uint64_t benchTime() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return ((uint64_t)t.tv_sec*1000000000ull + t.tv_nsec);
+}
+
+// keeps the compiler from optimizing away the benchmarked work
+static volatile uint32_t benchSink;
+static inline void benchEscape(const void * p) { asm volatile("" : : "r"(p) : "memory"); }
+
+#endif
@@ -0,0 +1,76 @@
+//
+//  engine.h - helpers for the tests of the whole engine on the host simulation
+//  part of the ESP32Sound library, https://github.com/ChrisVeigl/ESP32Sound
+//
+//  The output of a test (the DAC value of every sample period, see hostOutput()) is
+//  compared with golden/<name>.wav. With the argument --update the golden file is written.
+//  If the output differs, it is written to golden/<name>.actual.wav for listening.
+//
+//  This code is released under GPLv3 license.
+//  see: https://www.gnu.org/licenses/gpl-3.0.en.html and https://www.fsf.org/
+
+#ifndef _engine_H_
+#define _engine_H_
+
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include "check.h"
+#include "wavfile.h"
+#include "HostSim.h"
+#include "ESP32Sound.h"
+
+#define GOLDEN_DIR "golden/"
+
+static inline bool updateGolden(int argc, char ** argv) {
+    return ((argc > 1) && (!strcmp(argv[1], "--update")));
+}
+
+// compares 8-bit output samples with the golden file, returns false if they differ
+static inline bool checkGolden(const char * name, const std::vector<uint8_t> & out, uint32_t rate, bool update) {
+    std::string path = std::string(GOLDEN_DIR) + name + ".wav";
+    if (update) {
+        CHECK(saveWav(path.c_str(), rate, 8, 1, &out[0], out.size()));
+        printf("%s written (%u samples)\n", path.c_str(), (uint32_t)out.size());
+        return (true);
+    }
+    WavFile w;
+    bool ok = loadWav(path.c_str(), w) && (w.data.size() == out.size());
+    uint32_t i = 0;
+    if (ok) {
+        while ((i < out.size()) && (out[i] == w.data[i])) i++;
+        ok = (i == out.size());
+    }
+    if (!ok) {
+        printf("%s: output differs from %s at sample %u\n", name, path.c_str(), i);
+        saveWav((std::string(GOLDEN_DIR) + name + ".actual.wav").c_str(), rate, 8, 1, &out[0], out.size());
+    }
+    CHECK(ok);
+    return (ok);
+}
+
+// an FX array in the format of wav2array.py: 4 bytes length, 8-bit unsigned samples
+static inline std::vector<uint8_t> makeFx(uint32_t samples, double freq, double amplitude, uint32_t rate=16000) {
+    std::vector<uint8_t> fx(samples+4);
+    wavPut32(&fx[0], samples);
+    for (uint32_t i=0; i<samples; i++)
+        fx[i+4] = (uint8_t) lround(128 + amplitude*127*sin(2*M_PI*freq*i/rate));
+    return (fx);
+}
+
+// writes a 16-bit PCM .wav file of n frames, the sample of frame i and channel c is f(i, c)
+template <typename F> static inline bool writeTestWav(const std::string & path, uint32_t rate, uint16_t channels, 
+                                                      uint32_t n, F f) {
+    std::vector<int16_t> s(n*channels);
+    for (uint32_t i=0; i<n; i++) 
+        for (uint16_t c=0; c<channels; c++) s[i*channels+c] = f(i, c);
+    return (saveWav(path.c_str(), rate, 16, channels, &s[0], s.size()*2));
+}
+
+// a new temporary directory for the files of a test
+static inline std::string tempDir() {
+    char path[] = "/tmp/esp32sound_XXXXXX";
+    return (mkdtemp(path) ? path : "/tmp");
+}
+
+#endif
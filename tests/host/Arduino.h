@@ -0,0 +1,98 @@
+//
+//  Arduino.h - minimal Arduino / FreeRTOS API for the host build of the ESP32Sound library
+//  part of the ESP32Sound library, https://github.com/ChrisVeigl/ESP32Sound
+//
+//  Only the functions used by the library are provided. The tasks are threads which are
+//  scheduled by the host simulation (see HostSim.h): time is virtual, it only advances
+//  when all tasks sleep, so a test runs faster than real time and gives the same output
+//  on every run. Critical sections are spinlocks, as on the ESP32.
+//
+//  This code is released under GPLv3 license.
+//  see: https://www.gnu.org/licenses/gpl-3.0.en.html and https://www.fsf.org/
+
+#ifndef _Arduino_H_
+#define _Arduino_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sched.h>
+
+typedef bool boolean;
+
+#define IRAM_ATTR
+#define PI 3.1415926535897932384626433832795
+#define OUTPUT 0x03
+#define LOW  0x0
+#define HIGH 0x1
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+void dacWrite(uint8_t pin, uint8_t value);
+uint8_t hostDacValue(uint8_t pin);       // the value last written to a DAC pin
+unsigned long micros();                  // virtual time of the simulation
+unsigned long millis();
+void delay(uint32_t ms);                 // runs the simulation for ms milliseconds
+
+// messages are written to stdout
+class HostSerial {
+  public:
+    void begin(unsigned long baud) {}
+    size_t printf(const char * format, ...);
+    size_t print(const char * s);
+    size_t println(const char * s="");
+};
+
+extern HostSerial Serial;
+
+// FreeRTOS (tick rate 1000 Hz)
+typedef int          BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t     TickType_t;
+typedef uint8_t      StackType_t;             // stack sizes are given in bytes, as on the ESP32
+typedef struct { int unused; } StaticTask_t;
+typedef struct SimTask *      TaskHandle_t;
+typedef struct SimSemaphore * SemaphoreHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+#define pdFALSE 0
+#define pdTRUE  1
+#define pdPASS  1
+#define portMAX_DELAY 0xffffffffUL
+#define portTICK_PERIOD_MS 1
+#define tskNO_AFFINITY 0x7fffffff
+#define configMAX_PRIORITIES 25
+#define taskYIELD() ((void)0)
+#define portYIELD_FROM_ISR() ((void)0)
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char * name, uint32_t stackSize, void * param,
+                                   UBaseType_t priority, TaskHandle_t * handle, BaseType_t core);
+BaseType_t xTaskCreate(TaskFunction_t fn, const char * name, uint32_t stackSize, void * param,
+                       UBaseType_t priority, TaskHandle_t * handle);
+TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t fn, const char * name, uint32_t stackSize, void * param,
+                                           UBaseType_t priority, StackType_t * stack, StaticTask_t * tcb, BaseType_t core);
+void vTaskDelete(TaskHandle_t task);      // only NULL (the calling task) is supported
+void vTaskDelay(TickType_t ticks);
+TaskHandle_t xTaskGetCurrentTaskHandle();
+BaseType_t xPortGetCoreID();              // the application runs on core 1
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t * woken);
+SemaphoreHandle_t xSemaphoreCreateMutex();
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
+
+typedef struct { volatile int owner; } portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED { 0 }
+
+static inline void portENTER_CRITICAL(portMUX_TYPE * m) {
+    while (__atomic_exchange_n(&m->owner, 1, __ATOMIC_ACQUIRE)) sched_yield();
+}
+static inline void portEXIT_CRITICAL(portMUX_TYPE * m) { __atomic_store_n(&m->owner, 0, __ATOMIC_RELEASE); }
+#define portENTER_CRITICAL_ISR(m) portENTER_CRITICAL(m)
+#define portEXIT_CRITICAL_ISR(m) portEXIT_CRITICAL(m)
+
+#endif
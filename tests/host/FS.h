@@ -0,0 +1,85 @@
+//
+//  FS.h - file system API of the Arduino core for the host build of the ESP32Sound library
+//  part of the ESP32Sound library, https://github.com/ChrisVeigl/ESP32Sound
+//
+//  A file system is a directory of the host (POSIX files). Reads can be delayed in the
+//  virtual time of the host simulation, to test the streaming pipeline with slow SD cards.
+//
+//  This code is released under GPLv3 license.
+//  see: https://www.gnu.org/licenses/gpl-3.0.en.html and https://www.fsf.org/
+
+#ifndef _FS_H_
+#define _FS_H_
+
+#include <memory>
+#include <string>
+#include "Arduino.h"
+
+#define FILE_READ  "r"
+#define FILE_WRITE "w"
+
+namespace fs {
+
+class FS;
+
+class FileImpl {
+  public:
+    FileImpl(FILE * f, const FS * fs);
+    ~FileImpl();
+    size_t read(uint8_t * buf, size_t n);
+    size_t write(const uint8_t * buf, size_t n);
+    bool seek(uint32_t pos);
+    size_t size();
+    size_t position();
+    void close();
+    bool isOpen() const { return (file != NULL); }
+
+  private:
+    FILE *     file;
+    const FS * fs;
+};
+
+// a handle to an open file, the file is closed with close() or when the last handle is gone
+class File {
+  public:
+    File() {}
+    File(std::shared_ptr<FileImpl> p) : impl(p) {}
+    operator bool() const { return (impl && impl->isOpen()); }
+    size_t read(uint8_t * buf, size_t n) { return (impl ? impl->read(buf, n) : 0); }
+    size_t write(const uint8_t * buf, size_t n) { return (impl ? impl->write(buf, n) : 0); }
+    bool seek(uint32_t pos) { return (impl ? impl->seek(pos) : false); }
+    size_t size() const { return (impl ? impl->size() : 0); }
+    size_t position() const { return (impl ? impl->position() : 0); }
+    void close() { if (impl) impl->close(); impl.reset(); }
+
+  private:
+    std::shared_ptr<FileImpl> impl;
+};
+
+class FS {
+  public:
+    FS(const char * root=".") : root(root), readUs(0), stallEvery(0), stallUs(0), reads(0) {}
+    File open(const char * path, const char * mode=FILE_READ) const;
+    bool exists(const char * path) const;
+    bool remove(const char * path) const;
+    // simulated SD timing: every read takes readUs, every stallEvery-th read additionally stallUs
+    void setLatency(uint32_t readUs, uint32_t stallEvery=0, uint32_t stallUs=0);
+    static uint32_t openFiles();     // files which are open now (all file systems)
+
+  private:
+    friend class FileImpl;
+    void delayRead() const;
+
+    std::string       root;
+    uint32_t          readUs;
+    uint32_t          stallEvery;
+    uint32_t          stallUs;
+    mutable uint32_t  reads;
+};
+
+}
+
+using fs::FS;
+using fs::File;
+
+#endif
@@ -0,0 +1,446 @@
+//
+//  HostSim - simulation of the ESP32 for the host build of the ESP32Sound library
+//  part of the ESP32Sound library, https://github.com/ChrisVeigl/ESP32Sound
+//
+//  Scheduler, FreeRTOS and Arduino functions and the POSIX file system, see HostSim.h.
+//  A task is "quiet" if it waits and its wait condition is false. The virtual clock only
+//  advances if all tasks are quiet. Tasks which are woken during a tick (by the timer ISR)
+//  only run after the tick, like tasks which are woken by an interrupt on the ESP32.
+//
+//  This code is released under GPLv3 license.
+//  see: https://www.gnu.org/licenses/gpl-3.0.en.html and https://www.fsf.org/
+
+#include <stdarg.h>
+#include <chrono>
+#include <condition_variable>
+#include <thread>
+#include "Arduino.h"
+#include "FS.h"
+#include "HostSim.h"
+
+#define SIM_DEFAULT_RATE 16000
+#define SIM_TICK_NS 1000000ULL          // FreeRTOS tick: 1 ms
+#define SIM_STUCK_SECONDS 20            // real time after which a task which never waits is reported
+#define SIM_DEADLOCK_NS (600*1000000000ULL)   // virtual time after which a wait of the application is reported
+
+struct SimTask {
+    const char *          name;
+    bool                  isTask;       // false: the application thread
+    bool                  waiting;
+    bool                  dead;
+    uint32_t              notify;       // FreeRTOS task notification value
+    uint32_t              wakeups;
+    uint64_t              deadline;
+    std::function<bool()> cond;
+};
+
+struct SimSemaphore {
+    bool taken;
+};
+
+struct SimTaskDeleted {};
+
+namespace {
+
+struct Sim {
+    std::mutex              lock;
+    std::condition_variable cv;
+    std::vector<SimTask *>  tasks;
+    uint64_t                now;
+    uint64_t                rem;        // remainder of the sample period (ns * rate)
+    uint32_t                rate;
+    bool                    inTick;     // set while the tick runs, and after exit (no task runs again)
+    void                    (*tick)();
+    uint8_t                 dac[2];
+};
+
+void simShutdown();
+
+// never destroyed: the task threads still wait on it when the application exits
+Sim & sim() {
+    static Sim * s = NULL;
+    static std::once_flag once;
+    std::call_once(once, [] {
+        s = new Sim();
+        s->now = s->rem = 0;
+        s->rate = SIM_DEFAULT_RATE;
+        s->inTick = false;
+        s->tick = NULL;
+        s->dac[0] = s->dac[1] = 0;
+        atexit(simShutdown);
+    });
+    return (*s);
+}
+
+thread_local SimTask * self = NULL;
+
+SimTask * current() {
+    if (!self) {
+        self = new SimTask();
+        self->name = "app";
+        self->isTask = false;
+        self->waiting = self->dead = false;
+        self->notify = self->wakeups = 0;
+        self->deadline = SIM_FOREVER;
+    }
+    return (self);
+}
+
+bool ready(const SimTask * t) {
+    return ((t->cond && t->cond()) || (sim().now >= t->deadline));
+}
+
+bool quiet() {
+    for (SimTask * t : sim().tasks)
+        if ((!t->dead) && ((!t->waiting) || ready(t))) return (false);
+    return (true);
+}
+
+void waitQuiet(std::unique_lock<std::mutex> & lock) {
+    Sim & s = sim();
+    auto limit = std::chrono::steady_clock::now() + std::chrono::seconds(SIM_STUCK_SECONDS);
+    while (!quiet()) {
+        if ((s.cv.wait_until(lock, limit) == std::cv_status::timeout) && (!quiet())) {
+            for (SimTask * t : s.tasks)
+                if ((!t->dead) && (!t->waiting)) fprintf(stderr, "HostSim: task %s does not wait\n", t->name);
+            abort();
+        }
+    }
+}
+
+// one sample period: the tick runs while all tasks wait
+void step(std::unique_lock<std::mutex> & lock) {
+    Sim & s = sim();
+    s.inTick = true;
+    lock.unlock();
+    if (s.tick) s.tick();
+    lock.lock();
+    uint64_t t = 1000000000ULL + s.rem;
+    s.now += t / s.rate;
+    s.rem = t % s.rate;
+    s.inTick = false;
+    s.cv.notify_all();
+}
+
+// at exit the tasks are stopped where they wait, before the static objects are destroyed
+void simShutdown() {
+    std::unique_lock<std::mutex> lock(sim().lock);
+    waitQuiet(lock);
+    sim().inTick = true;
+}
+
+uint64_t ticksToNs(TickType_t ticks) {
+    return (ticks == portMAX_DELAY ? SIM_FOREVER : ticks * SIM_TICK_NS);
+}
+
+void startTask(TaskFunction_t fn, const char * name, void * param, TaskHandle_t * handle) {
+    SimTask * t = new SimTask();
+    t->name = name;
+    t->isTask = true;
+    t->waiting = t->dead = false;
+    t->notify = t->wakeups = 0;
+    t->deadline = SIM_FOREVER;
+    {
+        std::lock_guard<std::mutex> lock(sim().lock);
+        sim().tasks.push_back(t);
+    }
+    if (handle) *handle = t;
+    std::thread([t, fn, param] {
+        self = t;
+        try {
+            fn(param);
+        } catch (SimTaskDeleted &) {
+        }
+        std::lock_guard<std::mutex> lock(sim().lock);
+        t->dead = true;
+        sim().cv.notify_all();
+    }).detach();
+}
+
+}
+
+std::mutex & simMutex() {
+    return (sim().lock);
+}
+
+bool simWait(std::unique_lock<std::mutex> & lock, const std::function<bool()> & cond, uint64_t timeoutNs) {
+    Sim & s = sim();
+    SimTask * t = current();
+    if (cond()) return (true);
+    if (!timeoutNs) return (false);
+    uint64_t deadline = (timeoutNs == SIM_FOREVER) ? SIM_FOREVER : s.now + timeoutNs;
+
+    if (t->isTask) {
+        t->cond = cond;
+        t->deadline = deadline;
+        t->waiting = true;
+        s.cv.notify_all();
+        s.cv.wait(lock, [&] { return ((!s.inTick) && ((cond()) || (s.now >= deadline))); });
+        t->waiting = false;
+        t->cond = nullptr;
+        t->deadline = SIM_FOREVER;
+        t->wakeups++;
+        return (cond());
+    }
+
+    // the application waits: the simulation runs until the condition is true
+    uint64_t start = s.now;
+    while (1) {
+        waitQuiet(lock);
+        if (cond()) return (true);
+        if (s.now >= deadline) return (false);
+        if ((deadline == SIM_FOREVER) && (s.now - start > SIM_DEADLOCK_NS)) {
+            fprintf(stderr, "HostSim: the application waits forever (deadlock)\n");
+            abort();
+        }
+        step(lock);
+    }
+}
+
+void simWakeAll() {
+    sim().cv.notify_all();
+}
+
+void simSleepUs(uint32_t us) {
+    std::unique_lock<std::mutex> lock(sim().lock);
+    simWait(lock, [] { return (false); }, (uint64_t)us * 1000);
+}
+
+uint64_t simNowNs() {
+    std::lock_guard<std::mutex> lock(sim().lock);
+    return (sim().now);
+}
+
+void simSetTick(void (*tick)()) {
+    std::lock_guard<std::mutex> lock(sim().lock);
+    sim().tick = tick;
+}
+
+void simSetRate(uint32_t rate) {
+    std::lock_guard<std::mutex> lock(sim().lock);
+    if (rate) sim().rate = rate;
+}
+
+void hostRun(uint32_t samples) {
+    std::unique_lock<std::mutex> lock(sim().lock);
+    for (uint32_t i=0; i<samples; i++) {
+        waitQuiet(lock);
+        step(lock);
+    }
+    waitQuiet(lock);
+}
+
+uint32_t hostTaskWakeups(const char * name) {
+    std::lock_guard<std::mutex> lock(sim().lock);
+    uint32_t n = 0;
+    for (SimTask * t : sim().tasks)
+        if (!strcmp(t->name, name)) n += t->wakeups;
+    return (n);
+}
+
+// Arduino
+
+HostSerial Serial;
+
+size_t HostSerial::printf(const char * format, ...) {
+    va_list args;
+    va_start(args, format);
+    int n = vprintf(format, args);
+    va_end(args);
+    return (n > 0 ? n : 0);
+}
+
+size_t HostSerial::print(const char * s) {
+    return (fputs(s, stdout) >= 0 ? strlen(s) : 0);
+}
+
+size_t HostSerial::println(const char * s) {
+    return (print(s) + print("\n"));
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {}
+void digitalWrite(uint8_t pin, uint8_t val) {}
+
+void dacWrite(uint8_t pin, uint8_t value) {
+    sim().dac[pin & 1] = value;
+}
+
+uint8_t hostDacValue(uint8_t pin) {
+    return (sim().dac[pin & 1]);
+}
+
+unsigned long micros() {
+    return (simNowNs() / 1000);
+}
+
+unsigned long millis() {
+    return (simNowNs() / 1000000);
+}
+
+void delay(uint32_t ms) {
+    vTaskDelay(ms);
+}
+
+// FreeRTOS
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char * name, uint32_t stackSize, void * param,
+                                   UBaseType_t priority, TaskHandle_t * handle, BaseType_t core) {
+    startTask(fn, name, param, handle);
+    return (pdPASS);
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char * name, uint32_t stackSize, void * param,
+                       UBaseType_t priority, TaskHandle_t * handle) {
+    startTask(fn, name, param, handle);
+    return (pdPASS);
+}
+
+TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t fn, const char * name, uint32_t stackSize, void * param,
+                                           UBaseType_t priority, StackType_t * stack, StaticTask_t * tcb, BaseType_t core) {
+    TaskHandle_t handle;
+    startTask(fn, name, param, &handle);
+    return (handle);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    if ((task == NULL) || (task == self)) throw SimTaskDeleted();
+}
+
+void vTaskDelay(TickType_t ticks) {
+    std::unique_lock<std::mutex> lock(sim().lock);
+    simWait(lock, [] { return (false); }, ticksToNs(ticks));
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    return (current());
+}
+
+BaseType_t xPortGetCoreID() {
+    return (1);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks) {
+    std::unique_lock<std::mutex> lock(sim().lock);
+    SimTask * t = current();
+    simWait(lock, [t] { return (t->notify > 0); }, ticksToNs(ticks));
+    uint32_t value = t->notify;
+    if (value) t->notify = clearOnExit ? 0 : value-1;
+    return (value);
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    std::lock_guard<std::mutex> lock(sim().lock);
+    task->notify++;
+    sim().cv.notify_all();
+    return (pdPASS);
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t * woken) {
+    std::lock_guard<std::mutex> lock(sim().lock);
+    if (woken) *woken = task->waiting ? pdTRUE : pdFALSE;
+    task->notify++;
+    sim().cv.notify_all();
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+    SemaphoreHandle_t sem = new SimSemaphore();
+    sem->taken = false;
+    return (sem);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks) {
+    std::unique_lock<std::mutex> lock(sim().lock);
+    if (!simWait(lock, [sem] { return (!sem->taken); }, ticksToNs(ticks))) return (pdFALSE);
+    sem->taken = true;
+    return (pdTRUE);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) {
+    std::lock_guard<std::mutex> lock(sim().lock);
+    sem->taken = false;
+    sim().cv.notify_all();
+    return (pdTRUE);
+}
+
+// file system
+
+namespace fs {
+
+static uint32_t filesOpen = 0;
+
+FileImpl::FileImpl(FILE * f, const FS * fs) : file(f), fs(fs) {
+    __atomic_add_fetch(&filesOpen, 1, __ATOMIC_RELAXED);
+}
+
+FileImpl::~FileImpl() {
+    close();
+}
+
+size_t FileImpl::read(uint8_t * buf, size_t n) {
+    if (!file) return (0);
+    fs->delayRead();
+    return (fread(buf, 1, n, file));
+}
+
+size_t FileImpl::write(const uint8_t * buf, size_t n) {
+    return (file ? fwrite(buf, 1, n, file) : 0);
+}
+
+bool FileImpl::seek(uint32_t pos) {
+    return ((file) && (pos <= size()) && (!fseek(file, pos, SEEK_SET)));
+}
+
+size_t FileImpl::size() {
+    if (!file) return (0);
+    long pos = ftell(file);
+    fseek(file, 0, SEEK_END);
+    long end = ftell(file);
+    fseek(file, pos, SEEK_SET);
+    return (end);
+}
+
+size_t FileImpl::position() {
+    return (file ? ftell(file) : 0);
+}
+
+void FileImpl::close() {
+    if (!file) return;
+    fclose(file);
+    file = NULL;
+    __atomic_sub_fetch(&filesOpen, 1, __ATOMIC_RELAXED);
+}
+
+File FS::open(const char * path, const char * mode) const {
+    FILE * f = fopen((root + path).c_str(), *mode == 'w' ? "wb" : "rb");
+    if (!f) return (File());
+    return (File(std::make_shared<FileImpl>(f, this)));
+}
+
+bool FS::exists(const char * path) const {
+    FILE * f = fopen((root + path).c_str(), "rb");
+    if (f) fclose(f);
+    return (f != NULL);
+}
+
+bool FS::remove(const char * path) const {
+    return (!::remove((root + path).c_str()));
+}
+
+void FS::setLatency(uint32_t us, uint32_t every, uint32_t stall) {
+    readUs = us;
+    stallEvery = every;
+    stallUs = stall;
+}
+
+uint32_t FS::openFiles() {
+    return (__atomic_load_n(&filesOpen, __ATOMIC_RELAXED));
+}
+
+void FS::delayRead() const {
+    uint32_t us = readUs;
+    reads++;
+    if ((stallEvery) && (!(reads % stallEvery))) us += stallUs;
+    if (us) simSleepUs(us);
+}
+
+}
@@ -0,0 +1,44 @@
+//
+//  HostSim - simulation of the ESP32 for the host build of the ESP32Sound library
+//  part of the ESP32Sound library, https://github.com/ChrisVeigl/ESP32Sound
+//
+//  The FreeRTOS tasks of the library are threads, but only one thing happens at a time
+//  in virtual time: the simulation waits until all tasks sleep (blocked on a notification,
+//  a semaphore, a timeout or a simulated SD read), then it calls the sample timer (or
+//  the I2S DMA) once and advances the virtual clock by one sample period. The output
+//  is therefore the same on every run and independent of the speed of the host.
+//  The application thread (main) drives the simulation: hostRun(), delay() and every
+//  blocking FreeRTOS call of the application let the virtual time run.
+//  The DAC value of every sample period is captured, see hostOutput().
+//
+//  This code is released under GPLv3 license.
+//  see: https://www.gnu.org/licenses/gpl-3.0.en.html and https://www.fsf.org/
+
+#ifndef _HostSim_H_
+#define _HostSim_H_
+
+#include <stdint.h>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#define SIM_FOREVER 0xffffffffffffffffULL
+
+// lock of the simulation state (tasks, notifications, semaphores, DMA buffers)
+std::mutex & simMutex();
+// blocks the calling thread until cond() is true (returns true) or timeoutNs of virtual time
+// passed (returns false). lock must hold simMutex(), cond is evaluated with the lock held.
+bool simWait(std::unique_lock<std::mutex> & lock, const std::function<bool()> & cond, uint64_t timeoutNs);
+void simWakeAll();                           // call with the lock held after changing state which a cond reads
+void simSleepUs(uint32_t us);                // sleeps in virtual time
+uint64_t simNowNs();
+// the platform: tick is called once per sample period (without the lock held, all tasks sleep)
+void simSetTick(void (*tick)());
+void simSetRate(uint32_t rate);
+
+// for tests and benchmarks
+void hostRun(uint32_t samples);              // runs the simulation for the given number of sample periods
+std::vector<uint8_t> & hostOutput();         // DAC value of every sample period since the start (or clear())
+uint32_t hostTaskWakeups(const char * name); // how often the task(s) with this name were woken (context switches)
+
+#endif
@@ -0,0 +1,111 @@
+//
+//  SoundPlatform - hardware access of the ESP32Sound library (host implementation)
+//  part of the ESP32Sound library, https://github.com/ChrisVeigl/ESP32Sound
+//
+//  The sample timer and the I2S DMA are driven by the virtual clock of the host simulation
+//  (see HostSim.h), the DAC value of every sample period is captured for the tests.
+//  Partitions are files: soundMapPartition() maps the file with the given name.
+//
+//  This code is released under GPLv3 license.
+//  see: https://www.gnu.org/licenses/gpl-3.0.en.html and https://www.fsf.org/
+
+#include <chrono>
+#include <deque>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "SoundPlatform.h"
+#include "HostSim.h"
+
+static void (*timerIsr)() = NULL;
+static volatile bool timerEnabled = false;
+static bool i2sMode = false;
+static uint32_t dmaFrames = 0;          // capacity of the DMA buffers (frames)
+static std::deque<uint16_t> dma;        // queued frames (one channel), protected by simMutex()
+static std::vector<uint8_t> output;
+
+// one sample period: the timer ISR writes a sample to the DAC, or the DMA sends one frame
+static void platformTick() {
+    if (i2sMode) {
+        std::lock_guard<std::mutex> lock(simMutex());
+        if (!dma.empty()) {
+            dacWrite(DAC_PIN, dma.front() >> 8);
+            dma.pop_front();
+            simWakeAll();
+        }
+    }
+    else if ((timerEnabled) && (timerIsr)) timerIsr();
+    output.push_back(hostDacValue(DAC_PIN));
+}
+
+void soundPlatformInit(){
+    pinMode(AMP_PIN, OUTPUT);
+    digitalWrite(AMP_PIN, HIGH);
+    simSetTick(platformTick);
+}
+
+// the mapping is never released, as on the ESP32
+const uint8_t * soundMapPartition(const char * label, uint32_t & size){
+    struct stat st;
+    int fd = open(label, O_RDONLY);
+    if (fd < 0) return (NULL);
+    if (fstat(fd, &st) || (st.st_size <= 0)) {
+        close(fd);
+        return (NULL);
+    }
+    void * p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) return (NULL);
+    size = st.st_size;
+    return ((const uint8_t *) p);
+}
+
+void soundTimerBegin(void (*isr)(), uint32_t rate){
+    dacWrite(DAC_PIN, 127);
+    timerEnabled = false;
+    timerIsr = isr;
+    soundTimerSetRate(rate);
+}
+
+void soundTimerSetRate(uint32_t rate){
+    simSetRate(rate);
+}
+
+void soundTimerEnable(){
+    timerEnabled = true;
+}
+
+void soundTimerDisable(){
+    timerEnabled = false;
+}
+
+void soundI2SBegin(uint32_t rate, uint16_t blockSize){
+    i2sMode = true;
+    dmaFrames = (uint32_t)I2S_DMA_BUFFERS*blockSize;
+    dacWrite(DAC_PIN, 127);
+    simSetRate(rate);
+}
+
+void soundI2SSetRate(uint32_t rate){
+    simSetRate(rate);
+}
+
+// blocks (in virtual time) until the DMA buffers have space for the frames
+void soundI2SWrite(const uint16_t * frames, uint16_t count){
+    std::unique_lock<std::mutex> lock(simMutex());
+    simWait(lock, [count] { return (dma.size()+count <= dmaFrames); }, SIM_FOREVER);
+    for (uint16_t i=0; i<count; i++) dma.push_back(frames[2*i]);
+}
+
+uint32_t soundCycleCount(){
+#if defined(__x86_64__) || defined(__i386__)
+    return ((uint32_t)__builtin_ia32_rdtsc());
+#else
+    return ((uint32_t)(std::chrono::steady_clock::now().time_since_epoch().count()));
+#endif
+}
+
+std::vector<uint8_t> & hostOutput() {
+    return (output);
+}
@@ -0,0 +1,180 @@
+//
+//  test_adpcm - unit test of the IMA-ADPCM block decoder (SoundAdpcm)
+//  part of the ESP32Sound library, https://github.com/ChrisVeigl/ESP32Sound
+//
+//  A sine is encoded with the standard IMA-ADPCM encoder (the encoder tracks the 
+//  predictor of the decoder), the decoded blocks must match the predictor of the 
+//  encoder exactly, for mono and stereo files and all supported block sizes.
+//  With the arguments <file.wav> <file.raw> a file written by convertTool/adpcm.py is 
+//  decoded and compared with the samples decoded by the python script.
+//  With the arguments --fx <fx.bin> <fx.raw> a compressed FX of adpcm.encode_fx() is decoded 
+//  sample by sample like in the mixer (imaAdpcmDecode) and compared with its 8-bit source (SNR).
+//
+//  This code is released under GPLv3 license.
+//  see: https://www.gnu.org/licenses/gpl-3.0.en.html and https://www.fsf.org/
+
+#include <math.h>
+#include <vector>
+#include "check.h"
+#include "wavfile.h"
+#include "SoundAdpcm.h"
+
+// reference decoder, written along the IMA-ADPCM specification
+static int refDecode(int nibble, int & predictor, int & index) {
+    int step = imaStepTable[index];
+    int diff = step >> 3;
+    if (nibble & 4) diff += step;
+    if (nibble & 2) diff += step >> 1;
+    if (nibble & 1) diff += step >> 2;
+    predictor += (nibble & 8) ? -diff : diff;
+    predictor = predictor < -32768 ? -32768 : (predictor > 32767 ? 32767 : predictor);
+    index += imaIndexTable[nibble];
+    index = index < 0 ? 0 : (index > 88 ? 88 : index);
+    return (predictor);
+}
+
+static int encode(int sample, int & predictor, int & index) {
+    int step = imaStepTable[index], diff = sample - predictor, nibble = 0;
+    if (diff < 0) { nibble = 8; diff = -diff; }
+    if (diff >= step) { nibble |= 4; diff -= step; }
+    if (diff >= step >> 1) { nibble |= 2; diff -= step >> 1; }
+    if (diff >= step >> 2) nibble |= 1;
+    refDecode(nibble, predictor, index);
+    return (nibble);
+}
+
+// encodes the channels into blocks, ref is set to the samples of the left channel as decoded by the encoder
+static std::vector<uint8_t> encodeBlocks(const std::vector<int16_t> * ch, uint16_t channels, uint16_t blockAlign, 
+                                         std::vector<int16_t> & ref) {
+    uint32_t spb = imaAdpcmSamplesPerBlock(blockAlign, channels);
+    uint32_t blocks = ch[0].size()/spb;
+    std::vector<uint8_t> out(blocks*blockAlign);
+    int index[2] = {0, 0};
+    for (uint32_t b=0; b<blocks; b++) {
+        uint8_t * blk = &out[b*blockAlign];
+        const int16_t * in[2] = { &ch[0][b*spb], &ch[channels-1][b*spb] };
+        for (uint16_t c=0; c<channels; c++) {
+            int predictor = in[c][0];
+            wavPut16(blk+4*c, predictor);
+            blk[4*c+2] = index[c];
+            blk[4*c+3] = 0;
+            if (c==0) ref.push_back(predictor);
+            // groups of 8 samples (4 bytes) per channel, interleaved
+            for (uint32_t i=1, g=0; i<spb; i+=8, g++) {
+                uint8_t * p = blk + 4*channels + (g*channels + c)*4;
+                for (uint8_t k=0; k<8; k++) {
+                    int nibble = encode(in[c][i+k], predictor, index[c]);
+                    if (c==0) ref.push_back(predictor);
+                    if (k & 1) p[k/2] |= nibble << 4;
+                    else p[k/2] = nibble;
+                }
+            }
+        }
+    }
+    return (out);
+}
+
+static void testBlocks(uint16_t channels, uint16_t blockAlign) {
+    uint32_t spb = imaAdpcmSamplesPerBlock(blockAlign, channels);
+    CHECK_EQ(spb, (blockAlign-4*channels)*2/channels+1);
+    std::vector<int16_t> ch[2];
+    for (uint16_t c=0; c<channels; c++)
+        for (uint32_t i=0; i<spb*10; i++) 
+            ch[c].push_back((int16_t) (12000*sin(2*M_PI*(c ? 1000 : 440)*i/16000) + (i%7)*50));
+    std::vector<int16_t> ref;
+    std::vector<uint8_t> data = encodeBlocks(ch, channels, blockAlign, ref);
+    std::vector<int16_t> out(spb*10+1, 0x5555);
+    CHECK_EQ(ima_adpcm_to_s16_mono(&data[0], &out[0], 10, blockAlign, channels), spb*10);
+    CHECK_EQ(out[spb*10], 0x5555);
+    uint32_t errors=0;
+    double sig=0, err=0;
+    for (uint32_t i=0; i<spb*10; i++) {
+        if (out[i] != ref[i]) errors++;
+        sig += (double)ch[0][i]*ch[0][i];
+        err += (double)(out[i]-ch[0][i])*(out[i]-ch[0][i]);
+    }
+    double snr = 10*log10(sig/err);
+    printf("%d channel(s), block %d: %u samples per block, SNR %.1f dB\n", channels, blockAlign, spb, snr);
+    CHECK_EQ(errors, 0);
+    CHECK(snr > 20);
+}
+
+// a file written by convertTool/adpcm.py and the samples decoded by the script
+static void testPython(const char * wavPath, const char * rawPath) {
+    WavFile w;
+    CHECK(loadWav(wavPath, w));
+    CHECK_EQ(w.format, WAV_FORMAT_IMA_ADPCM);
+    FILE * f = fopen(rawPath, "rb");
+    CHECK(f != NULL);
+    if ((!f) || (w.format != WAV_FORMAT_IMA_ADPCM)) return;
+    std::vector<int16_t> ref;
+    int16_t v;
+    while (fread(&v, 2, 1, f) == 1) ref.push_back(v);
+    fclose(f);
+    uint32_t blocks = w.data.size()/w.blockAlign;
+    std::vector<int16_t> out(blocks*imaAdpcmSamplesPerBlock(w.blockAlign, w.channels));
+    uint32_t n = ima_adpcm_to_s16_mono(&w.data[0], &out[0], blocks, w.blockAlign, w.channels);
+    CHECK_EQ(n, ref.size());
+    uint32_t errors=0;
+    for (uint32_t i=0; (i<n) && (i<ref.size()); i++) if (out[i] != ref[i]) errors++;
+    printf("%s: %u samples decoded\n", wavPath, n);
+    CHECK_EQ(errors, 0);
+}
+
+static std::vector<uint8_t> readFile(const char * path) {
+    std::vector<uint8_t> d;
+    FILE * f = fopen(path, "rb");
+    CHECK(f != NULL);
+    if (!f) return (d);
+    int c;
+    while ((c = fgetc(f)) != EOF) d.push_back(c);
+    fclose(f);
+    return (d);
+}
+
+// round trip of a compressed FX: header (24-bit length, format), predictor, step index, 0, nibbles (low first)
+static void testFx(const char * fxPath, const char * rawPath) {
+    std::vector<uint8_t> fx = readFile(fxPath), src = readFile(rawPath);
+    CHECK(fx.size() > 8);
+    if (fx.size() <= 8) return;
+    uint32_t n = fx[0] | (fx[1]<<8) | (fx[2]<<16);
+    CHECK_EQ(fx[3] & 0x0f, 1);               // FX_FORMAT_ADPCM4
+    CHECK_EQ(n, src.size());
+    CHECK_EQ(fx.size(), 8 + (n+1)/2);
+    if ((n != src.size()) || (fx.size() != 8 + (n+1)/2)) return;
+    int16_t predictor = (int16_t)(fx[4] | (fx[5]<<8));
+    int8_t index = fx[6];
+    double sig=0, err=0;
+    int maxErr=0;
+    for (uint32_t i=0; i<n; i++) {
+        uint8_t b = fx[8+i/2];
+        int out = imaAdpcmDecode((i & 1) ? b>>4 : b & 0x0f, predictor, index);
+        int in = (src[i]-128) << 8;
+        sig += (double)in*in;
+        err += (double)(out-in)*(out-in);
+        if (abs(out-in) > maxErr) maxErr = abs(out-in);
+    }
+    double snr = 10*log10(sig/err);
+    printf("%s: %u samples, SNR %.1f dB, largest error %.1f 8-bit steps\n", fxPath, n, snr, maxErr/256.0);
+    CHECK(snr > 25);
+    CHECK(maxErr < 16*256);
+}
+
+int main(int argc, char ** argv) {
+    if ((argc == 4) && (!strcmp(argv[1], "--fx"))) {
+        testFx(argv[2], argv[3]);
+        return (checkResult("test_adpcm (python FX)"));
+    }
+    if (argc == 3) {
+        testPython(argv[1], argv[2]);
+        return (checkResult("test_adpcm (python reference)"));
+    }
+    uint16_t sizes[] = { 256, 512, 1024, 2048 };
+    for (uint8_t i=0; i<4; i++) {
+        testBlocks(1, sizes[i]);
+        testBlocks(2, sizes[i]);
+    }
+    CHECK_EQ(imaAdpcmSamplesPerBlock(4, 1), 0);
+    CHECK_EQ(imaAdpcmSamplesPerBlock(8, 2), 0);
+    return (checkResult("test_adpcm"));
+}
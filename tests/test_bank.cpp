@@ -0,0 +1,116 @@
+//
+//  test_bank - unit test of the FX bank index (SoundBank)
+//  part of the ESP32Sound library, https://github.com/ChrisVeigl/ESP32Sound
+//
+//  An image built in memory checks the validation of attach() (broken images are rejected).
+//  With the argument <dir> the images written by convertTool/wav2bank.py (see bank_reference.py)
+//  are mapped with mapFile() and compared with the .wav files they were made of.
+//
+//  This code is released under GPLv3 license.
+//  see: https://www.gnu.org/licenses/gpl-3.0.en.html and https://www.fsf.org/
+
+#include <math.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include "check.h"
+#include "wavfile.h"
+#include "SoundBank.h"
+#include "SoundAdpcm.h"
+
+// an image with the FX "a" (10 samples of 8 bits) and "b" (5 samples of 4 bits)
+static std::vector<uint8_t> makeImage() {
+    std::vector<uint8_t> img(SOUNDBANK_HEADER_SIZE + 2*SOUNDBANK_ENTRY_SIZE, 0);
+    memcpy(&img[0], SOUNDBANK_MAGIC, 4);
+    wavPut16(&img[4], SOUNDBANK_VERSION);
+    wavPut16(&img[6], 2);
+    const char * names[] = { "a", "b" };
+    uint32_t samples[] = { 10, 5 }, len[] = { 10, 4+3 };
+    uint8_t bits[] = { SOUNDBANK_BITS_PCM, SOUNDBANK_BITS_ADPCM };
+    for (int i=0; i<2; i++) {
+        uint8_t * e = &img[SOUNDBANK_HEADER_SIZE + i*SOUNDBANK_ENTRY_SIZE];
+        strcpy((char *) e, names[i]);
+        wavPut32(e+SOUNDBANK_NAME_LEN+4, samples[i]);
+        wavPut16(e+SOUNDBANK_NAME_LEN+8, 16000);
+        e[SOUNDBANK_NAME_LEN+10] = bits[i];
+        img.resize((img.size()+3) & ~3);
+        wavPut32(e+SOUNDBANK_NAME_LEN, img.size());
+        for (uint32_t k=0; k<len[i]; k++) img.push_back(i*100+k);
+    }
+    return (img);
+}
+
+static void testAttach() {
+    std::vector<uint8_t> img = makeImage();
+    SoundBank bank;
+    CHECK(bank.attach(&img[0], img.size()));
+    CHECK_EQ(bank.count(), 2);
+    CHECK_EQ(bank.find("b"), 1);
+    CHECK_EQ(bank.find("c"), SOUNDBANK_NOT_FOUND);
+    CHECK_EQ(bank.samples(0), 10);
+    CHECK_EQ(bank.bits(1), SOUNDBANK_BITS_ADPCM);
+    CHECK_EQ(bank.data(1)[0], 100);
+    CHECK(bank.data(2) == NULL);
+    CHECK(!bank.attach(&img[0], img.size()-1));       // the data of "b" is cut off
+    CHECK(!bank.valid());
+    std::vector<uint8_t> bad = img;
+    bad[0] = 'X';
+    CHECK(!bank.attach(&bad[0], bad.size()));
+    bad = img;
+    wavPut32(&bad[SOUNDBANK_HEADER_SIZE+SOUNDBANK_NAME_LEN], 2);      // offset not aligned
+    CHECK(!bank.attach(&bad[0], bad.size()));
+    bad = img;
+    memset(&bad[SOUNDBANK_HEADER_SIZE], 'x', SOUNDBANK_NAME_LEN);     // name not terminated
+    CHECK(!bank.attach(&bad[0], bad.size()));
+    bad = img;
+    bad[SOUNDBANK_HEADER_SIZE+SOUNDBANK_NAME_LEN+10] = 16;           // unknown format
+    CHECK(!bank.attach(&bad[0], bad.size()));
+}
+
+// a bank of wav2bank.py: the FX must be the samples of the .wav files (ADPCM: SNR of the decoded samples)
+static void testImage(const std::string & dir, const char * image, uint8_t bits) {
+    SoundBank bank;
+    CHECK(bank.mapFile((dir + "/" + image).c_str()));
+    CHECK_EQ(bank.count(), 2);
+    const char * names[] = { "tone", "chirp" };
+    for (uint16_t i=0; i<2; i++) {
+        WavFile w;
+        CHECK(loadWav((dir + "/" + names[i] + ".wav").c_str(), w));
+        int16_t id = bank.find(names[i]);
+        CHECK_EQ(id, i);
+        if (id < 0) continue;
+        CHECK(!strcmp(bank.name(id), names[i]));
+        CHECK_EQ(bank.samples(id), w.data.size());
+        CHECK_EQ(bank.rate(id), 16000);
+        CHECK_EQ(bank.bits(id), bits);
+        const uint8_t * d = bank.data(id);
+        CHECK(((d - bank.data(0)) & 3) == 0);
+        if (bank.samples(id) != w.data.size()) continue;
+        if (bits == SOUNDBANK_BITS_PCM) {
+            CHECK(!memcmp(d, &w.data[0], w.data.size()));
+            continue;
+        }
+        int16_t predictor = (int16_t)(d[0] | (d[1]<<8));
+        int8_t index = d[2];
+        double sig=0, err=0;
+        for (uint32_t k=0; k<w.data.size(); k++) {
+            int out = imaAdpcmDecode((k & 1) ? d[4+k/2]>>4 : d[4+k/2] & 0x0f, predictor, index);
+            int in = (w.data[k]-128) << 8;
+            sig += (double)in*in;
+            err += (double)(out-in)*(out-in);
+        }
+        printf("%s: %s, SNR %.1f dB\n", image, names[i], 10*log10(sig/err));
+        CHECK(10*log10(sig/err) > 25);
+    }
+    printf("%s: %u FX\n", image, bank.count());
+}
+
+int main(int argc, char ** argv) {
+    if (argc == 2) {
+        testImage(argv[1], "bank_pcm.bin", SOUNDBANK_BITS_PCM);
+        testImage(argv[1], "bank_adpcm.bin", SOUNDBANK_BITS_ADPCM);
+        return (checkResult("test_bank (wav2bank.py)"));
+    }
+    testAttach();
+    return (checkResult("test_bank"));
+}
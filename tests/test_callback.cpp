@@ -0,0 +1,111 @@
+//
+//  test_callback - control functions called from the callbacks of the stream task
+//  part of the ESP32Sound library, https://github.com/ChrisVeigl/ESP32Sound
+//
+//  The sound callback (file opened) and the pull callback run on the stream task. If they call
+//  a function which waits for the stream task (seekToSample(), setPlaybackRate(), stopSound()),
+//  the command must be applied at once: the stream task cannot wait for itself.
+//
+//  This code is released under GPLv3 license.
+//  see: https://www.gnu.org/licenses/gpl-3.0.en.html and https://www.fsf.org/
+
+#include <unistd.h>
+#include "engine.h"
+
+#define RATE 16000
+#define SEEK_TO 20000
+
+enum { SEEK, SPEED, STOP };
+static uint8_t action;
+static uint8_t result;
+static uint32_t calls;
+
+static void opened(soundHandle_t, uint8_t state) {
+    if (state != SOUND_PLAYING) return;
+    calls++;
+    switch (action) {
+        case SEEK: result = ESP32Sound.seekToSample(SEEK_TO); break;
+        case SPEED: ESP32Sound.setPlaybackRate(2*RATE); result = 1; break;
+        case STOP: ESP32Sound.stopSound(); result = 1; break;
+    }
+}
+
+// plays the file, the sound callback does the action
+static soundHandle_t play(fs::FS & sd, uint8_t what) {
+    action = what;
+    result = 0;
+    calls = 0;
+    soundHandle_t h = ESP32Sound.playSound(sd, "/music.wav");
+    CHECK(h != SOUND_NO_HANDLE);
+    hostRun(RATE/4);
+    CHECK_EQ(calls, 1);
+    CHECK_EQ(result, 1);
+    return (h);
+}
+
+static uint32_t pullCalls;
+
+// a sine; the third call stops the music and sets the (same) playback rate
+static uint32_t pull(int16_t * buf, uint32_t n) {
+    static uint32_t phase = 0;
+    for (uint32_t i=0; i<n; i++) buf[i] = (int16_t) lround(4000*sin(2*M_PI*500*(phase++)/RATE));
+    if (++pullCalls == 3) {
+        ESP32Sound.stopSound();
+        ESP32Sound.setPlaybackRate(RATE);
+    }
+    return (n);
+}
+
+int main() {
+    std::string dir = tempDir();
+    CHECK(writeTestWav(dir + "/music.wav", RATE, 1, RATE*3, [](uint32_t i, uint16_t) {
+        return ((int16_t) lround(8000*sin(2*M_PI*440*i/RATE)));
+    }));
+    fs::FS sd(dir.c_str());
+
+    ESP32Sound.setVerbosity(0);
+    ESP32Sound.begin(RATE);
+    ESP32Sound.setSoundCallback(opened);
+
+    // the seek is applied before the first sample is played
+    soundHandle_t h = play(sd, SEEK);
+    uint32_t pos = ESP32Sound.getPositionSamples();
+    printf("seek in the callback: position %u\n", pos);
+    CHECK((pos >= SEEK_TO) && (pos <= SEEK_TO + RATE/4));
+    ESP32Sound.stopSound();
+    hostRun(0);
+
+    // the resamplers follow the new rate: the 16kHz file is played at half the output rate
+    h = play(sd, SPEED);
+    uint32_t from = ESP32Sound.getPositionSamples();
+    hostRun(2*RATE);
+    pos = ESP32Sound.getPositionSamples() - from;
+    printf("playback rate set in the callback: %u samples of the file in %u output samples\n", pos, 2*RATE);
+    CHECK(abs((int32_t)pos - RATE) <= 2);
+    CHECK_EQ(ESP32Sound.getStats().underruns, 0);
+    ESP32Sound.stopSound();
+    ESP32Sound.setPlaybackRate(RATE);
+    hostRun(0);
+
+    h = play(sd, STOP);
+    CHECK_EQ(ESP32Sound.getSoundState(h), SOUND_FINISHED);
+    CHECK(!ESP32Sound.isPlaying());
+    CHECK_EQ(fs::FS::openFiles(), 0);
+
+    // the pull callback stops the music
+    ESP32Sound.setSoundCallback(NULL);
+    h = ESP32Sound.playSound(sd, "/music.wav");
+    hostRun(RATE/4);
+    ESP32Sound.setPullCallback(pull);
+    hostRun(RATE/2);
+    printf("pull callback: %u calls\n", pullCalls);
+    CHECK(pullCalls > 3);
+    CHECK_EQ(ESP32Sound.getSoundState(h), SOUND_FINISHED);
+    ESP32Sound.setPullCallback(NULL);
+    hostRun(0);
+    CHECK_EQ(fs::FS::openFiles(), 0);
+
+    sd.remove("/music.wav");
+    rmdir(dir.c_str());
+    return (checkResult("test_callback"));
+}
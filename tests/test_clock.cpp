@@ -0,0 +1,122 @@
+//
+//  test_clock - the 64-bit sample clock (getSampleClock64()) and the output latency
+//  part of the ESP32Sound library, https://github.com/ChrisVeigl/ESP32Sound
+//
+//  The clock is preset just below 2^32 (hostSetSampleClock()): while the mixer renders across
+//  the wrap of the lower half, a second thread reads the clock without locks, the values must
+//  be monotonic (a torn read of the two halves would jump by 2^32). FX scheduled across the wrap
+//  start at their sample. The clock keeps running while paused, as FX continue then.
+//  getOutputLatencySamples() is 0 with the timer and the DMA buffers in I2S mode: an FX
+//  scheduled at a sample clock value is heard this number of samples later (within one block,
+//  as the output task renders the next block before the DMA buffers have space).
+//
+//  This code is released under GPLv3 license.
+//  see: https://www.gnu.org/licenses/gpl-3.0.en.html and https://www.fsf.org/
+
+#include <atomic>
+#include <thread>
+#include "engine.h"
+
+#define RATE 16000
+#define WRAP 0x100000000ull
+#define ROUNDS 200000
+
+static std::vector<uint8_t> constFx(uint32_t n, int v) {
+    std::vector<uint8_t> fx(n+4, 128+v);
+    wavPut32(&fx[0], n);
+    return (fx);
+}
+
+static void testWrap() {
+    std::atomic<bool> done(false);
+    std::atomic<uint32_t> reads(0), bad(0);
+    // the clock is preset to an even multiple of 2^32 in each round: a torn read is not within
+    // 2 samples of one (upper half odd with a small lower half, or even with a large one)
+    ESP32Sound.hostSetSampleClock(2*WRAP - 2);
+    std::thread reader([&] {
+        uint64_t last = 0;
+        while (!done) {
+            uint64_t clock = ESP32Sound.getSampleClock64();
+            if ((clock < last) || ((clock+2) % (2*WRAP) > 4)) bad++;
+            last = clock;
+            reads++;
+        }
+    });
+    uint8_t out[4];
+    uint32_t wrong = 0;
+    for (uint64_t k=2; k<=2*ROUNDS; k+=2) {
+        if (k > 2) ESP32Sound.hostSetSampleClock(k*WRAP - 2);
+        ESP32Sound.renderBlock(out, 4);
+        if ((ESP32Sound.getSampleClock64() != k*WRAP + 2) || (ESP32Sound.getSampleClock() != 2)) wrong++;
+    }
+    done = true;
+    reader.join();
+    printf("%u lock-free reads across %u wraps, %u not monotonic\n", (uint32_t)reads, ROUNDS, (uint32_t)bad);
+    CHECK(reads > 0);
+    CHECK_EQ(bad, 0);
+    CHECK_EQ(wrong, 0);
+}
+
+// an FX scheduled after the wrap of the lower half, from before the wrap
+static void testScheduledAcrossWrap() {
+    std::vector<uint8_t> fx = constFx(20, 100);
+    static uint8_t out[2000];
+    ESP32Sound.hostSetSampleClock(5*WRAP - 1000);
+    CHECK(ESP32Sound.playFxAt(&fx[0], ESP32Sound.getSampleClock()+1500));
+    ESP32Sound.renderBlock(out, sizeof(out));
+    uint32_t start = 0;
+    while ((start < sizeof(out)) && (out[start] < 127+50)) start++;
+    CHECK_EQ(start, 1500);
+    CHECK_EQ(ESP32Sound.getSampleClock64(), 5*WRAP + 1000);
+}
+
+// pause() stops the music only, FX and scheduled FX need the clock
+static void testPaused() {
+    std::vector<uint8_t> fx = constFx(20, 100);
+    uint8_t out[100];
+    ESP32Sound.pause();
+    uint64_t clock = ESP32Sound.getSampleClock64();
+    CHECK(ESP32Sound.playFxAfter(&fx[0], 50));
+    ESP32Sound.renderBlock(out, sizeof(out));
+    CHECK_EQ(ESP32Sound.getSampleClock64(), clock+100);
+    CHECK(out[49] < 127+50);
+    CHECK(out[50] > 127+50);
+    ESP32Sound.resume();
+}
+
+// the number of samples between the sample clock of a scheduled FX and its first output sample
+static uint32_t measureLatency() {
+    std::vector<uint8_t> fill = constFx(RATE, 0), fx = constFx(20, 100);
+    CHECK(ESP32Sound.playFx(&fill[0]) != FX_NO_VOICE);     // silence, keeps the output running
+    hostRun(RATE/10);
+    uint32_t index = hostOutput().size(), clock = ESP32Sound.getSampleClock();
+    CHECK(ESP32Sound.playFxAt(&fx[0], clock+1000));
+    hostRun(RATE/10);
+    uint32_t i = index;
+    while ((i < hostOutput().size()) && (hostOutput()[i] < 127+50)) i++;
+    ESP32Sound.stopAllFx();
+    hostRun(RATE/10);
+    return (i - index - 1000);
+}
+
+int main() {
+    ESP32Sound.setVerbosity(0);
+    ESP32Sound.begin(RATE);
+    ESP32Sound.setFxVolume(100);
+    hostRun(0);             // the stream task applies the volume
+    CHECK_EQ(ESP32Sound.getOutputLatencySamples(), 0);
+    testWrap();
+    testScheduledAcrossWrap();
+    testPaused();
+    uint32_t latency = measureLatency();
+    printf("timer: latency %u samples, measured %u\n", ESP32Sound.getOutputLatencySamples(), latency);
+    CHECK_EQ(latency, 0);
+
+    // the output task is created by begin(): the I2S output stays active from here on
+    ESP32Sound.begin(RATE, DEFAULT_SOUNDBUF_SIZE, SOUND_OUTPUT_I2S, 128);
+    CHECK_EQ(ESP32Sound.getOutputLatencySamples(), I2S_DMA_BUFFERS*128);
+    latency = measureLatency();
+    printf("I2S: latency %u samples, measured %u\n", ESP32Sound.getOutputLatencySamples(), latency);
+    CHECK((latency >= I2S_DMA_BUFFERS*128) && (latency <= (I2S_DMA_BUFFERS+1)*128));
+    return (checkResult("test_clock"));
+}
@@ -0,0 +1,97 @@
+//
+//  test_commands - the command path from the API to the stream task
+//  part of the ESP32Sound library, https://github.com/ChrisVeigl/ESP32Sound
+//
+//  A caller which waits for its command (seekToSample() in a second task, held up by SD stalls)
+//  must not block other callers: a preload() of the application returns at once (without 
+//  advancing the virtual time). The seek returns its own result.
+//  Volume changes while the stream task is busy (it opens a file on a slow SD card) must
+//  end with the latest volume, also when more changes are made than the command ring holds.
+//
+//  This code is released under GPLv3 license.
+//  see: https://www.gnu.org/licenses/gpl-3.0.en.html and https://www.fsf.org/
+
+#include <unistd.h>
+#include "engine.h"
+
+#define RATE 16000
+#define LEVEL 12000
+
+static volatile uint8_t seeking, seekResult;
+
+static void seekTask(void *) {
+    seekResult = ESP32Sound.seekToSample(44100);
+    seeking = 0;
+    vTaskDelete(NULL);
+}
+
+static void testWaiting(fs::FS & sd) {
+    sd.setLatency(2000, 4, 30000);
+    uint32_t worst = 0, overlaps = 0;
+    for (uint32_t k=0; k<20; k++) {
+        soundHandle_t a = ESP32Sound.playSound(sd, "/music1.wav");
+        CHECK(a != SOUND_NO_HANDLE);
+        hostRun(RATE/4 + k*97);
+        seeking = 1;
+        xTaskCreatePinnedToCore(seekTask, "seek", 2048, NULL, 1, NULL, 1);
+        hostRun(0);                       // the seek is posted, the stream task may wait for the reader task
+        uint8_t pending = seeking;
+        uint64_t t = simNowNs();
+        soundHandle_t b = ESP32Sound.preload(sd, "/music2.wav");
+        uint32_t us = (simNowNs()-t) / 1000;
+        if (pending) {
+            overlaps++;
+            if (us > worst) worst = us;
+        }
+        CHECK(b != SOUND_NO_HANDLE);
+        hostRun(RATE/4);
+        CHECK(!seeking);
+        CHECK_EQ(seekResult, 1);
+        CHECK_EQ(ESP32Sound.getSoundState(b), SOUND_PRELOADED);
+        ESP32Sound.stopSound();
+        hostRun(0);
+    }
+    printf("preload() during %u of 20 waiting seeks: blocked at most %u us\n", overlaps, worst);
+    CHECK(overlaps > 0);
+    CHECK_EQ(worst, 0);
+    sd.setLatency(0);
+}
+
+static void testVolume(fs::FS & sd) {
+    std::vector<uint8_t> & out = hostOutput();
+    sd.setLatency(20000);
+    soundHandle_t h = ESP32Sound.playSound(sd, "/plus.wav");
+    hostRun(0);                           // the stream task reads the header of the file
+    for (uint8_t v=1; v<=40; v++) ESP32Sound.setSoundVolume(v);     // more than the command ring holds
+    sd.setLatency(0);
+    hostRun(RATE/2);
+    CHECK_EQ(ESP32Sound.getSoundState(h), SOUND_PLAYING);
+    double sum = 0;
+    for (uint32_t i=out.size()-RATE/4; i<out.size(); i++) sum += out[i];
+    double level = sum/(RATE/4) - 127, expected = LEVEL/256.0*0.4;
+    printf("40 volume changes: level %.2f steps (%.2f expected)\n", level, expected);
+    CHECK(fabs(level - expected) < 0.5);
+    ESP32Sound.stopSound();
+    hostRun(0);
+}
+
+int main() {
+    std::string dir = tempDir();
+    fs::FS sd(dir.c_str());
+    CHECK(writeTestWav(dir + "/plus.wav", RATE, 1, RATE*5, [](uint32_t, uint16_t) { return ((int16_t) LEVEL); }));
+    for (uint8_t i=1; i<=2; i++)
+        CHECK(writeTestWav(dir + "/music" + (char)('0'+i) + ".wav", 44100, 2, 44100*5, [i](uint32_t n, uint16_t c) {
+            return ((int16_t) lround(8000*sin(2*M_PI*(c ? 330 : 220)*i*n/44100)));
+        }));
+
+    ESP32Sound.setVerbosity(0);
+    ESP32Sound.begin(RATE);
+    testWaiting(sd);
+    testVolume(sd);
+    CHECK_EQ(fs::FS::openFiles(), 0);
+
+    const char * files[] = { "/plus.wav", "/music1.wav", "/music2.wav" };
+    for (uint8_t i=0; i<3; i++) sd.remove(files[i]);
+    rmdir(dir.c_str());
+    return (checkResult("test_commands"));
+}
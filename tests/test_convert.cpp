@@ -0,0 +1,54 @@
+//
+//  test_convert - unit test of the PCM conversion kernels (SoundConvert)
+//  part of the ESP32Sound library, https://github.com/ChrisVeigl/ESP32Sound
+//
+//  Each kernel is compared with a sample-by-sample reference for all lengths 
+//  up to 67 frames (all tail cases of the word-wise loops) and unaligned buffers.
+//
+//  This code is released under GPLv3 license.
+//  see: https://www.gnu.org/licenses/gpl-3.0.en.html and https://www.fsf.org/
+
+#include <stdlib.h>
+#include "check.h"
+#include "SoundConvert.h"
+
+#define MAX_FRAMES 67
+
+// the left channel of a frame as 16-bit signed sample
+static int16_t reference(const uint8_t * in, uint32_t i, uint16_t bits, uint16_t channels) {
+    const uint8_t * p = in + i*(bits/8)*channels;
+    if (bits==8) return ((int16_t)((p[0]-128)*256));
+    return ((int16_t)(p[0] | (p[1]<<8)));
+}
+
+int main() {
+    uint16_t layouts[4][2] = { {8,1}, {8,2}, {16,1}, {16,2} };
+    uint8_t in[MAX_FRAMES*4+1];
+    int16_t out[MAX_FRAMES+1];
+    srand(1);
+    for (uint32_t i=0; i<sizeof(in); i++) in[i]=rand();
+
+    for (uint8_t l=0; l<4; l++) {
+        uint16_t bits=layouts[l][0], channels=layouts[l][1];
+        soundConvertFunc f = getSoundConverter(bits, channels);
+        CHECK(f != NULL);
+        if (!f) continue;
+        for (uint8_t ofs=0; ofs<2; ofs++) {        // word-aligned and odd input address
+            for (uint32_t n=0; n<=MAX_FRAMES; n++) {
+                out[n]=0x5555;                     // guard: no sample after n is written
+                CHECK_EQ(f(in+ofs, out, n), n);
+                for (uint32_t i=0; i<n; i++) {
+                    if (out[i] != reference(in+ofs, i, bits, channels)) {
+                        printf("layout %d bits %d channels, n=%u, sample %u\n", bits, channels, n, i);
+                        CHECK_EQ(out[i], reference(in+ofs, i, bits, channels));
+                        break;
+                    }
+                }
+                CHECK_EQ(out[n], 0x5555);
+            }
+        }
+    }
+    CHECK(getSoundConverter(24, 1) == NULL);
+    CHECK(getSoundConverter(8, 3) == NULL);
+    return (checkResult("test_convert"));
+}
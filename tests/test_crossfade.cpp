@@ -0,0 +1,137 @@
+//
+//  test_crossfade - crossfades between music files on the host simulation
+//  part of the ESP32Sound library, https://github.com/ChrisVeigl/ESP32Sound
+//
+//  A crossfade from a file with a constant positive level to one with the negative level
+//  gives a linear ramp at the output: its length (fitted to the 8-bit output) must be the
+//  requested fade time, also for fades longer than 65536 samples.
+//  A crossfade under SD latency must not underrun: two 44.1kHz 16-bit stereo files (352KB/s)
+//  are read at the same time, every read takes 2ms and every 8th read stalls for 30ms
+//  (about 700KB/s on average; with a stall every 4th read the SD card is too slow for two streams).
+//  Built with SOUND_STREAMS=3: crossfadeTo() with all streams busy stops the oldest stream.
+//
+//  This code is released under GPLv3 license.
+//  see: https://www.gnu.org/licenses/gpl-3.0.en.html and https://www.fsf.org/
+
+#include <unistd.h>
+#include "engine.h"
+
+#define RATE 16000
+#define LEVEL 12000
+
+static std::string dir;
+
+// starts a file with full buffers (paused while the buffers are filled)
+static soundHandle_t start(fs::FS & sd, const char * path) {
+    ESP32Sound.pause();
+    soundHandle_t h = ESP32Sound.playSound(sd, path);
+    CHECK(h != SOUND_NO_HANDLE);
+    hostRun(RATE/4);
+    ESP32Sound.resume();
+    return (h);
+}
+
+static double mean(const std::vector<uint8_t> & out, uint32_t from, uint32_t n) {
+    double sum=0;
+    for (uint32_t i=from; i<from+n; i++) sum+=out[i];
+    return (sum/n);
+}
+
+// the length of the ramp of a crossfade of ms milliseconds, from the slope of a straight line
+// fitted to the middle half of the ramp
+static void testLength(fs::FS & sd, uint32_t ms) {
+    uint32_t n = (uint64_t)ms*RATE/1000;
+    soundHandle_t a = start(sd, "/plus.wav");
+    hostRun(RATE/2);
+    std::vector<uint8_t> & out = hostOutput();
+    uint32_t from = out.size();
+    double hi = mean(out, from-RATE/10, RATE/10);
+    soundHandle_t b = ESP32Sound.crossfadeTo(sd, "/minus.wav", ms);
+    CHECK(b != SOUND_NO_HANDLE);
+    hostRun(n + RATE/2);
+    double lo = mean(out, out.size()-RATE/10, RATE/10);
+    double sx=0, sy=0, sxx=0, sxy=0, k=0;
+    for (uint32_t i=from; i<out.size(); i++) {
+        if (fabs(out[i] - (hi+lo)/2) > (hi-lo)/4) continue;
+        sx+=i; sy+=out[i]; sxx+=(double)i*i; sxy+=(double)i*out[i]; k++;
+    }
+    double slope = (k*sxy - sx*sy) / (k*sxx - sx*sx);
+    double length = (lo-hi)/slope;
+    printf("crossfade of %u ms: levels %.1f -> %.1f, ramp of %.0f samples (%u expected)\n", ms, hi, lo, length, n);
+    CHECK(hi-lo > 60);
+    CHECK(fabs(length - n) < n/200.0);
+    CHECK_EQ(ESP32Sound.getSoundState(a), SOUND_FINISHED);
+    CHECK_EQ(ESP32Sound.getSoundState(b), SOUND_PLAYING);
+    ESP32Sound.stopSound();
+    hostRun(0);
+}
+
+static void testLatency(fs::FS & sd) {
+    sd.setLatency(2000, 8, 30000);
+    ESP32Sound.resetStats();
+    soundHandle_t a = start(sd, "/music1.wav");
+    hostRun(RATE);
+    soundHandle_t b = ESP32Sound.crossfadeTo(sd, "/music2.wav", 2000);
+    hostRun(RATE*3);
+    SoundStats st = ESP32Sound.getStats();
+    printf("crossfade with SD stalls of 30 ms: %u SD reads, slowest %u us, %u underruns\n",
+           st.sdReads, st.sdReadMaxUs, st.underruns);
+    CHECK_EQ(st.underruns, 0);
+    CHECK(st.sdReadMaxUs >= 32000);
+    CHECK_EQ(ESP32Sound.getSoundState(a), SOUND_FINISHED);
+    CHECK_EQ(ESP32Sound.getSoundState(b), SOUND_PLAYING);
+    ESP32Sound.stopSound();
+    hostRun(0);
+    sd.setLatency(0);
+}
+
+#if SOUND_STREAMS > 2
+// the streams are not used in start order: the oldest stream is not the one after the current one
+static void testOldest(fs::FS & sd) {
+    start(sd, "/plus.wav");                                            // stream 0
+    ESP32Sound.crossfadeTo(sd, "/minus.wav", 1000);                    // stream 1
+    hostRun(RATE*2);                                                   // stream 0 is free again
+    soundHandle_t b = ESP32Sound.crossfadeTo(sd, "/plus.wav", 3000);    // stream 0
+    hostRun(RATE/2);
+    soundHandle_t c = ESP32Sound.crossfadeTo(sd, "/minus.wav", 3000);   // stream 2
+    hostRun(RATE/2);
+    soundHandle_t d = ESP32Sound.crossfadeTo(sd, "/plus.wav", 3000);    // all busy: stream 1 is stopped
+    CHECK(d != SOUND_NO_HANDLE);
+    CHECK_EQ(ESP32Sound.getSoundState(b), SOUND_PLAYING);
+    CHECK_EQ(ESP32Sound.getSoundState(c), SOUND_PLAYING);
+    hostRun(RATE*4);
+    CHECK_EQ(ESP32Sound.getSoundState(b), SOUND_FINISHED);
+    CHECK_EQ(ESP32Sound.getSoundState(d), SOUND_PLAYING);
+    ESP32Sound.stopSound();
+    hostRun(0);
+}
+#endif
+
+int main() {
+    dir = tempDir();
+    fs::FS sd(dir.c_str());
+    auto constant = [](int16_t v) { return [v](uint32_t, uint16_t) { return (v); }; };
+    CHECK(writeTestWav(dir + "/plus.wav", RATE, 1, RATE*10, constant(LEVEL)));
+    CHECK(writeTestWav(dir + "/minus.wav", RATE, 1, RATE*10, constant(-LEVEL)));
+    for (uint8_t i=1; i<=2; i++)
+        CHECK(writeTestWav(dir + "/music" + (char)('0'+i) + ".wav", 44100, 2, 44100*5, [i](uint32_t n, uint16_t c) {
+            return ((int16_t) lround(8000*sin(2*M_PI*(c ? 330 : 220)*i*n/44100)));
+        }));
+
+    ESP32Sound.setVerbosity(0);
+    ESP32Sound.begin(RATE);
+    ESP32Sound.setSoundVolume(100);
+    hostRun(0);
+    testLength(sd, 1000);
+    testLength(sd, 6000);     // 96000 samples
+    testLatency(sd);
+#if SOUND_STREAMS > 2
+    testOldest(sd);
+#endif
+    CHECK_EQ(fs::FS::openFiles(), 0);
+
+    const char * files[] = { "/plus.wav", "/minus.wav", "/music1.wav", "/music2.wav" };
+    for (uint8_t i=0; i<4; i++) sd.remove(files[i]);
+    rmdir(dir.c_str());
+    return (checkResult("test_crossfade"));
+}
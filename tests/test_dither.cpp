@@ -0,0 +1,92 @@
+//
+//  test_dither - quantization of the mix bus to the 8-bit DAC (SOUND_DITHER)
+//  part of the ESP32Sound library, https://github.com/ChrisVeigl/ESP32Sound
+//
+//  Built once for each dither mode. 16-bit samples are pushed (pushSamples()) and rendered
+//  directly (renderBlock()), at 100% volume one DAC step is 256 on the bus.
+//  DC: the mean of the output of a constant between two DAC steps must be the exact value
+//  (dithered modes) or the rounded value (DITHER_NONE).
+//  Sine of 3 DAC steps at 1kHz: level of the fundamental, THD (harmonics 2-5) and the noise
+//  below 2kHz (without DC and the fundamental), both relative to the fundamental. The dither
+//  removes the harmonics, noise shaping moves the noise above 2kHz.
+//
+//  This code is released under GPLv3 license.
+//  see: https://www.gnu.org/licenses/gpl-3.0.en.html and https://www.fsf.org/
+
+#include "engine.h"
+
+#define RATE 16000
+#define CHUNK 1024
+
+static const char * modes[] = { "none", "tpdf", "noiseshape" };
+
+static std::vector<uint8_t> render(const std::vector<int16_t> & in) {
+    std::vector<uint8_t> out(in.size());
+    for (uint32_t i=0; i<in.size(); i+=CHUNK) {
+        uint32_t n = in.size()-i < CHUNK ? in.size()-i : CHUNK;
+        CHECK_EQ(ESP32Sound.pushSamples(&in[i], n), n);
+        ESP32Sound.renderBlock(&out[i], n);
+    }
+    return (out);
+}
+
+static void testDC(int16_t level) {
+    std::vector<int16_t> in(65536, level);
+    std::vector<uint8_t> out = render(in);
+    double sum=0;
+    for (uint32_t i=CHUNK; i<out.size(); i++) sum+=out[i];     // after the dither settled
+    double mean = sum/(out.size()-CHUNK), exact = 127 + level/256.0;
+    printf("%s: DC %.4f steps, mean of the output %.4f (%+.4f)\n", modes[SOUND_DITHER], exact, mean, mean-exact);
+#if SOUND_DITHER == DITHER_NONE
+    CHECK(fabs(mean - floor(exact+0.5)) < 1e-9);
+#else
+    CHECK(fabs(mean - exact) < 0.02);
+#endif
+}
+
+// power of the output at the frequency of DFT bin k (n samples), in DAC steps^2
+static double binPower(const std::vector<uint8_t> & out, uint32_t k) {
+    double re=0, im=0;
+    for (uint32_t i=0; i<out.size(); i++) {
+        re += out[i]*cos(2*M_PI*k*i/out.size());
+        im -= out[i]*sin(2*M_PI*k*i/out.size());
+    }
+    return ((re*re + im*im) * 2 / ((double)out.size()*out.size()));
+}
+
+static void testSine() {
+    std::vector<int16_t> in(RATE + CHUNK);
+    for (uint32_t i=0; i<in.size(); i++) in[i] = (int16_t) lround(3*256*sin(2*M_PI*1000*i/RATE));
+    std::vector<uint8_t> all = render(in);
+    std::vector<uint8_t> out(all.begin()+CHUNK, all.end());    // 1 second: bin k is k Hz
+    double fund = binPower(out, 1000), harm=0, noise=0;
+    for (uint32_t k=2; k<=5; k++) harm += binPower(out, k*1000);
+    for (uint32_t k=1; k<2000; k++) if (k != 1000) noise += binPower(out, k);
+    double level = sqrt(fund*2), thd = 10*log10(harm/fund), snr = 10*log10(noise/fund);
+    printf("%s: sine of %.3f steps (3 expected), THD %.1f dB, noise below 2kHz %.1f dB\n",
+           modes[SOUND_DITHER], level, thd, snr);
+    CHECK(fabs(level - 3) < 0.1);
+#if SOUND_DITHER == DITHER_NONE
+    CHECK(thd > -30);           // without dither, the quantization error is distortion
+#else
+    CHECK(thd < -40);
+#endif
+#if SOUND_DITHER == DITHER_TPDF
+    CHECK(snr < -15);           // 1/4 of a flat noise floor of 1/4 step^2: -18.6 dB
+#endif
+#if SOUND_DITHER == DITHER_NOISESHAPE
+    CHECK(snr < -22);           // first-order shaping: -25.6 dB
+#endif
+}
+
+int main() {
+    ESP32Sound.setVerbosity(0);
+    ESP32Sound.begin(RATE);
+    ESP32Sound.setSoundVolume(100);
+    hostRun(0);             // the stream task applies the volume
+    testDC(11*128);         // 5.5 steps
+    testDC(-900);           // -3.52 steps
+    testDC(64);             // 0.25 steps
+    testSine();
+    return (checkResult("test_dither"));
+}
@@ -0,0 +1,49 @@
+//
+//  test_engine - the whole engine on the host simulation, compared with a golden output
+//  part of the ESP32Sound library, https://github.com/ChrisVeigl/ESP32Sound
+//
+//  Plays music from a file (examples/playFromSD) and an FX on top of it in timer mode,
+//  stops the music and lets the FX end. The DAC output must be the same as golden/engine.wav.
+//  The simulation runs faster than real time and gives the same output on every run.
+//
+//  This code is released under GPLv3 license.
+//  see: https://www.gnu.org/licenses/gpl-3.0.en.html and https://www.fsf.org/
+
+#include "engine.h"
+
+int main(int argc, char ** argv) {
+    fs::FS sd("../examples/playFromSD/data");
+    std::vector<uint8_t> fx = makeFx(5000, 440, 0.8);
+
+    ESP32Sound.setVerbosity(0);
+    ESP32Sound.begin(16000);
+    soundHandle_t h = ESP32Sound.playSound(sd, "/sound1.wav");
+    CHECK(h != SOUND_NO_HANDLE);
+    CHECK(ESP32Sound.isPlaying());
+    hostRun(4000);
+    CHECK_EQ(ESP32Sound.getSoundState(h), SOUND_PLAYING);
+    CHECK_EQ(ESP32Sound.getPositionSamples(), 4000);
+    fxHandle_t v = ESP32Sound.playFx(&fx[0], 100);
+    CHECK(v != FX_NO_VOICE);
+    hostRun(4000);
+    ESP32Sound.stopSound();
+    CHECK_EQ(ESP32Sound.getSoundState(h), SOUND_FINISHED);
+    CHECK(ESP32Sound.isFxPlaying(v));
+    hostRun(2000);
+    CHECK(!ESP32Sound.isFxPlaying(v));
+    CHECK(!ESP32Sound.isPlaying());
+    CHECK_EQ(ESP32Sound.getStats().underruns, 0);
+    CHECK_EQ(fs::FS::openFiles(), 0);
+
+    std::vector<uint8_t> & out = hostOutput();
+    CHECK_EQ(out.size(), 10000);
+    uint8_t lo=255, hi=0;
+    for (uint32_t i=0; i<4000; i++) {
+        if (out[i] < lo) lo=out[i];
+        if (out[i] > hi) hi=out[i];
+    }
+    CHECK(hi-lo > 5);             // the music is audible (at the default volume)
+    CHECK_EQ(out.back(), 127);    // silence at the end
+    checkGolden("engine", out, 16000, updateGolden(argc, argv));
+    return (checkResult("test_engine"));
+}
@@ -0,0 +1,44 @@
+//
+//  test_fact - the length of IMA-ADPCM files is taken from the fact chunk
+//  part of the ESP32Sound library, https://github.com/ChrisVeigl/ESP32Sound
+//
+//  adpcm_256.wav of adpcm_reference.py has 20000 samples in 40 blocks of 505 samples:
+//  the last block is padded with 200 samples, which must not be played.
+//  Played at the file rate and resampled to 22050Hz and 8000Hz, and after a seek.
+//
+//  This code is released under GPLv3 license.
+//  see: https://www.gnu.org/licenses/gpl-3.0.en.html and https://www.fsf.org/
+
+#include "engine.h"
+
+#define FILE_SAMPLES 20000
+#define FILE_RATE 16000
+
+// plays the file to the end (from sample 'from'), returns the position at the end (in samples of the file)
+static uint32_t play(fs::FS & sd, uint32_t rate, uint32_t from=0) {
+    ESP32Sound.begin(rate);
+    ESP32Sound.pause();
+    soundHandle_t h = ESP32Sound.playSound(sd, "/adpcm_256.wav");
+    CHECK(h != SOUND_NO_HANDLE);
+    hostRun(0);
+    if (from) CHECK(ESP32Sound.seekToSample(from));
+    hostRun(0);
+    ESP32Sound.resume();
+    hostRun(rate*2);
+    CHECK_EQ(ESP32Sound.getSoundState(h), SOUND_FINISHED);
+    CHECK_EQ(ESP32Sound.getStats().underruns, 0);
+    CHECK_EQ(fs::FS::openFiles(), 0);     // closed after the end of playback
+    printf("%u Hz from %u: position %u at the end\n", rate, from, ESP32Sound.getPositionSamples());
+    return (ESP32Sound.getPositionSamples());
+}
+
+int main() {
+    fs::FS sd(ADPCM_DIR);
+    ESP32Sound.setVerbosity(0);
+
+    CHECK_EQ(play(sd, FILE_RATE), FILE_SAMPLES);
+    CHECK(abs((int32_t)play(sd, 22050) - FILE_SAMPLES) <= 1);
+    CHECK(abs((int32_t)play(sd, 8000) - FILE_SAMPLES) <= 1);
+    CHECK_EQ(play(sd, FILE_RATE, 10100), FILE_SAMPLES);    // block 20 starts with sample 10100
+    return (checkResult("test_fact"));
+}
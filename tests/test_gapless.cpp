@@ -0,0 +1,62 @@
+//
+//  test_gapless - looped and queued files are played without a gap at the track boundary
+//  part of the ESP32Sound library, https://github.com/ChrisVeigl/ESP32Sound
+//
+//  The file is a 400Hz sine of exactly 200 periods (40 samples each), played in a loop
+//  (setLoop(true), like the music of the FlappyBirdSound example). A gap, a lost or a
+//  repeated sample at a track boundary breaks the period of 40 samples of the output.
+//
+//  This code is released under GPLv3 license.
+//  see: https://www.gnu.org/licenses/gpl-3.0.en.html and https://www.fsf.org/
+
+#include <unistd.h>
+#include "engine.h"
+
+#define RATE 16000
+#define PERIOD 40
+#define FILE_SAMPLES (PERIOD*200)
+
+int main() {
+    std::string dir = tempDir();
+    CHECK(writeTestWav(dir + "/loop.wav", RATE, 1, FILE_SAMPLES, [](uint32_t i, uint16_t) {
+        return ((int16_t) lround(10000*sin(2*M_PI*i/PERIOD)));
+    }));
+    fs::FS sd(dir.c_str());
+
+    ESP32Sound.setVerbosity(0);
+    ESP32Sound.begin(RATE);
+    ESP32Sound.setSoundVolume(100);
+    ESP32Sound.setLoop(true);
+    CHECK(ESP32Sound.enqueue(sd, "/loop.wav"));
+    hostRun(FILE_SAMPLES*4 + RATE/2);
+    CHECK(ESP32Sound.isPlaying());
+    CHECK_EQ(ESP32Sound.getStats().underruns, 0);
+
+    std::vector<uint8_t> & out = hostOutput();
+    uint32_t first = 0;
+    while ((first < out.size()) && (abs(out[first]-127) <= 2)) first++;
+    CHECK(first < RATE/2);
+    uint32_t breaks = 0, at = 0;
+    uint8_t lo = 255, hi = 0;
+    for (uint32_t i=first; i+PERIOD < out.size(); i++) {
+        if (abs(out[i] - out[i+PERIOD]) > 2) {    // the dither changes a sample by at most 1
+            if (!breaks) at = i;
+            breaks++;
+        }
+        if (out[i] < lo) lo = out[i];
+        if (out[i] > hi) hi = out[i];
+    }
+    printf("%u samples from sample %u, level %u..%u, %u samples break the period (first at %u)\n",
+           (uint32_t)out.size()-first, first, lo, hi, breaks, at);
+    CHECK(hi - lo > 60);
+    CHECK(out.size()-first > FILE_SAMPLES*3);   // at least three track boundaries
+    CHECK_EQ(breaks, 0);
+
+    ESP32Sound.setLoop(false);
+    ESP32Sound.stopSound();
+    hostRun(0);
+    CHECK_EQ(fs::FS::openFiles(), 0);
+    sd.remove("/loop.wav");
+    rmdir(dir.c_str());
+    return (checkResult("test_gapless"));
+}
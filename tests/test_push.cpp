@@ -0,0 +1,126 @@
+//
+//  test_push - samples of the application: pushSamples(), getPushBuffer() / commitPush()
+//  part of the ESP32Sound library, https://github.com/ChrisVeigl/ESP32Sound
+//
+//  A producer which paces itself with availableForWrite() fills the buffer without ever losing
+//  a sample (pushSamples() takes all it was offered) and without underruns, a full buffer takes
+//  only the free space. The buffer which runs empty at the end of a burst is no underrun, a
+//  producer which continues too late is one. The zero-copy functions give the contiguous free
+//  space up to the end of the ring, the samples written there are played in order.
+//  While the pull callback is set, the functions of the push producer do not write.
+//
+//  This code is released under GPLv3 license.
+//  see: https://www.gnu.org/licenses/gpl-3.0.en.html and https://www.fsf.org/
+
+#include "engine.h"
+
+#define RATE 16000
+#define FRAME 267           // one frame of audio of an emulator at 60 fps
+
+static int16_t sine(uint32_t i) {
+    return ((int16_t) lround(6000*sin(2*M_PI*500*i/RATE)));
+}
+
+static void testBackpressure() {
+    int16_t buf[FRAME];
+    uint32_t phase = 0, frames = 0, bad = 0;
+    ESP32Sound.resetStats();
+    while (phase < 3*RATE) {
+        if (ESP32Sound.availableForWrite() < FRAME) {
+            hostRun(FRAME/4);       // the emulator waits for room for one frame
+            continue;
+        }
+        for (uint32_t i=0; i<FRAME; i++) buf[i] = sine(phase+i);
+        if (ESP32Sound.pushSamples(buf, FRAME) != FRAME) bad++;
+        if (ESP32Sound.availableForWrite() + ESP32Sound.getPushFill() != PUSH_BUFFER_SIZE) bad++;
+        phase += FRAME;
+        frames++;
+    }
+    SoundStats st = ESP32Sound.getStats();
+    printf("paced producer: %u frames, %u samples played, %u underruns\n", frames, st.samplesRendered, st.pushUnderruns);
+    CHECK_EQ(bad, 0);
+    CHECK_EQ(st.pushUnderruns, 0);
+    CHECK(st.samplesRendered + ESP32Sound.getPushFill() >= phase);
+
+    // a full buffer takes the free space only
+    static int16_t more[PUSH_BUFFER_SIZE];
+    uint32_t space = ESP32Sound.availableForWrite();
+    CHECK_EQ(ESP32Sound.pushSamples(more, PUSH_BUFFER_SIZE), space);
+    CHECK_EQ(ESP32Sound.availableForWrite(), 0);
+    CHECK_EQ(ESP32Sound.pushSamples(more, 1), 0);
+
+    // the end of the burst and a new one after a pause: no underrun
+    hostRun(RATE/2);
+    CHECK_EQ(ESP32Sound.getPushFill(), 0);
+    CHECK_EQ(ESP32Sound.pushSamples(buf, FRAME), FRAME);
+    hostRun(FRAME);
+    CHECK_EQ(ESP32Sound.getStats().pushUnderruns, 0);
+
+    // the producer continues 10ms after the buffer ran empty: an underrun
+    hostRun(RATE/100);
+    CHECK_EQ(ESP32Sound.pushSamples(buf, FRAME), FRAME);
+    hostRun(2*FRAME);
+    CHECK_EQ(ESP32Sound.getStats().pushUnderruns, 1);
+    hostRun(RATE/2);
+}
+
+// the samples written in place are played in order, also across the end of the ring
+static void testZeroCopy() {
+    static uint8_t out[PUSH_BUFFER_SIZE];
+    uint32_t written = 0, played = 0, bad = 0, pieces = 0;
+    for (uint32_t round=0; round<6; round++) {
+        uint32_t n;
+        int16_t * p = ESP32Sound.getPushBuffer(n);
+        CHECK(p != NULL);
+        CHECK(n <= ESP32Sound.availableForWrite());
+        // steps of 1/2 DAC step: -20..19 DAC steps
+        for (uint32_t i=0; i<n; i++) p[i] = (int16_t)(((int)((written+i) % 80) - 40) * 128);
+        ESP32Sound.commitPush(n);
+        written += n;
+        pieces++;
+        CHECK_EQ(ESP32Sound.getPushFill(), written-played);
+        uint32_t m = 700 + round*311;
+        if (m > written-played) m = written-played;
+        ESP32Sound.renderBlock(out, m);
+        for (uint32_t i=0; i<m; i++) {
+            int expected = 127 + (int)lround(((int)((played+i) % 80) - 40) / 2.0);
+            if (abs(out[i] - expected) > 1) bad++;
+        }
+        played += m;
+    }
+    printf("zero-copy: %u samples written in %u pieces, %u played\n", written, pieces, played);
+    CHECK(written > PUSH_BUFFER_SIZE);      // across the end of the ring
+    CHECK_EQ(bad, 0);
+    ESP32Sound.renderBlock(out, written-played);
+    CHECK_EQ(ESP32Sound.getPushFill(), 0);
+}
+
+static uint32_t pull(int16_t *, uint32_t) {
+    return (0);
+}
+
+// the pull callback is the producer: the push functions do not write
+static void testPullGuard() {
+    int16_t buf[16] = { 0 };
+    ESP32Sound.setPullCallback(pull);
+    hostRun(0);
+    uint32_t n = 1;
+    CHECK(ESP32Sound.getPushBuffer(n) == NULL);
+    CHECK_EQ(n, 0);
+    ESP32Sound.commitPush(16);
+    CHECK_EQ(ESP32Sound.pushSamples(buf, 16), 0);
+    CHECK_EQ(ESP32Sound.getPushFill(), 0);
+    ESP32Sound.setPullCallback(NULL);
+    hostRun(0);
+}
+
+int main() {
+    ESP32Sound.setVerbosity(0);
+    ESP32Sound.begin(RATE);
+    ESP32Sound.setSoundVolume(100);
+    hostRun(0);             // the stream task applies the volume
+    testBackpressure();
+    testZeroCopy();
+    testPullGuard();
+    return (checkResult("test_push"));
+}
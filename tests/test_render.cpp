@@ -0,0 +1,140 @@
+//
+//  test_render - unit test of the block renderer (ESP32Sound::renderBlock)
+//  part of the ESP32Sound library, https://github.com/ChrisVeigl/ESP32Sound
+//
+//  The renderer is called directly (the sample timer of the simulation is not run).
+//  FX with constant sample values give known DAC values: silence is 127, one DAC
+//  step is 1% of full scale at 100% volume. The dither changes the values by at most 1.
+//
+//  This code is released under GPLv3 license.
+//  see: https://www.gnu.org/licenses/gpl-3.0.en.html and https://www.fsf.org/
+
+#include "engine.h"
+
+// an FX of n samples with the constant value 128+v
+static std::vector<uint8_t> constFx(uint32_t n, int v) {
+    std::vector<uint8_t> fx(n+4, 128+v);
+    wavPut32(&fx[0], n);
+    return (fx);
+}
+
+// checks that out[from..to) is level +-1 and that the mean is level +-0.5
+static void checkLevel(const uint8_t * out, uint32_t from, uint32_t to, int level) {
+    double sum=0;
+    uint32_t bad=0;
+    for (uint32_t i=from; i<to; i++) {
+        if (abs(out[i]-level) > 1) bad++;
+        sum+=out[i];
+    }
+    CHECK_EQ(bad, 0);
+    CHECK(fabs(sum/(to-from)-level) < 0.5);
+}
+
+static void testSilence() {
+    uint8_t out[128];
+    memset(out, 0, sizeof(out));
+    uint32_t clock = ESP32Sound.getSampleClock();
+    CHECK(!ESP32Sound.renderBlock(out, 128));
+    for (int i=0; i<128; i++) CHECK_EQ(out[i], 127);
+    CHECK_EQ(ESP32Sound.getSampleClock()-clock, 128);
+}
+
+// an FX ends with the exact sample, then the renderer runs until the peak meter decayed
+static void testFxLength() {
+    std::vector<uint8_t> fx = constFx(300, 100);
+    static uint8_t out[8192];
+    CHECK(ESP32Sound.playFx(&fx[0], 100) != FX_NO_VOICE);
+    uint32_t n=0;
+    while ((n < sizeof(out)-128) && (ESP32Sound.renderBlock(out+n, 128))) n+=128;
+    checkLevel(out, 0, 300, 227);
+    checkLevel(out, 300, n, 127);
+    for (uint32_t i=300; i<n+128; i++) if (out[i]!=127) { CHECK_EQ(out[i], 127); break; }
+    CHECK_EQ(ESP32Sound.getPeak(), 0);
+    CHECK(n > 300);
+}
+
+// voices are summed with their volumes, the sum is saturated
+static void testMix() {
+    std::vector<uint8_t> a = constFx(1000, 60), b = constFx(1000, 80), c = constFx(1000, 120), d = constFx(1000, -60);
+    uint8_t out[256];
+    ESP32Sound.playFx(&a[0], 100);
+    ESP32Sound.playFx(&b[0], 50);
+    ESP32Sound.renderBlock(out, 256);
+    checkLevel(out, 0, 256, 127+60+40);
+    ESP32Sound.playFx(&c[0], 100);
+    ESP32Sound.renderBlock(out, 256);
+    for (int i=0; i<256; i++) CHECK(out[i] >= 254);   // 60+40+120 steps: saturated
+    ESP32Sound.stopAllFx();
+    ESP32Sound.playFx(&a[0], 100);
+    ESP32Sound.playFx(&d[0], 100);   // cancels out
+    ESP32Sound.renderBlock(out, 256);
+    checkLevel(out, 0, 256, 127);
+    ESP32Sound.stopAllFx();
+}
+
+// blocks of any size give the same output: one FX rendered once in blocks of 1 and once in blocks of 128
+static void testBlockSizes() {
+    std::vector<uint8_t> fx = makeFx(1024, 1000, 0.7);
+    std::vector<uint8_t> x(1024), y(1024);
+    ESP32Sound.playFx(&fx[0], 100);
+    for (int i=0; i<1024; i++) ESP32Sound.renderBlock(&x[i], 1);
+    ESP32Sound.playFx(&fx[0], 100);
+    for (int i=0; i<1024; i+=128) ESP32Sound.renderBlock(&y[i], 128);
+    uint32_t diff=0;
+    for (int i=0; i<1024; i++) if (abs(x[i]-y[i]) > 2) diff++;   // only the dither differs
+    CHECK_EQ(diff, 0);
+    for (int i=0; i<1024; i++) CHECK(abs(x[i] - (127 + fx[i+4]-128)) <= 1);
+}
+
+// scheduled FX start exactly at their sample, also inside a block and across block boundaries,
+// in any order of scheduling; an event in the past starts with the next sample
+static void testEventOffsets(uint16_t block) {
+    std::vector<uint8_t> a = constFx(20, 100), b = constFx(20, -100), c = constFx(20, 50);
+    std::vector<int> expected(512, 127);
+    uint8_t out[512];
+    uint32_t clock = ESP32Sound.getSampleClock();
+    CHECK(ESP32Sound.playFxAt(&a[0], clock+300));
+    CHECK(ESP32Sound.playFxAt(&b[0], clock+127));
+    CHECK(ESP32Sound.playFxAt(&a[0], clock+37));
+    CHECK(ESP32Sound.playFxAt(&c[0], clock-5));
+    for (int i=0; i<20; i++) {
+        expected[i] = 127+50;
+        expected[37+i] = 127+100;
+        expected[127+i] = 127-100;
+        expected[300+i] = 127+100;
+    }
+    for (uint32_t n=0; n<sizeof(out); n+=block) ESP32Sound.renderBlock(out+n, block);
+    uint32_t bad=0;
+    for (int i=0; i<512; i++) if (abs(out[i]-expected[i]) > 1) bad++;
+    CHECK_EQ(bad, 0);
+}
+
+// a stolen voice counts its remaining samples as dropped
+static void testStealing() {
+    std::vector<uint8_t> fx = constFx(1000, 10);
+    uint8_t out[100];
+    ESP32Sound.resetStats();
+    for (uint8_t i=0; i<FX_VOICES; i++) CHECK(ESP32Sound.playFx(&fx[0], 50) != FX_NO_VOICE);
+    ESP32Sound.renderBlock(out, 100);
+    CHECK_EQ(ESP32Sound.getStats().samplesDropped, 0);
+    CHECK(ESP32Sound.playFx(&fx[0], 50) != FX_NO_VOICE);     // replaces the oldest FX
+    CHECK_EQ(ESP32Sound.getStats().samplesDropped, 900);
+    ESP32Sound.stopAllFx();
+    ESP32Sound.resetStats();
+    CHECK_EQ(ESP32Sound.getStats().samplesDropped, 0);
+}
+
+int main() {
+    ESP32Sound.setVerbosity(0);
+    ESP32Sound.begin(16000);
+    ESP32Sound.setFxVolume(100);
+    hostRun(0);             // the stream task applies the volume
+    testSilence();
+    testFxLength();
+    testMix();
+    testBlockSizes();
+    testStealing();
+    testEventOffsets(1);
+    testEventOffsets(128);
+    return (checkResult("test_render"));
+}
@@ -0,0 +1,93 @@
+//
+//  test_resampler - unit test of the streaming sample rate converter (SoundResampler)
+//  part of the ESP32Sound library, https://github.com/ChrisVeigl/ESP32Sound
+//
+//  Checks the output length, the signal-to-noise ratio of a converted sine for both 
+//  quality levels, and that the output does not depend on the chunk sizes.
+//
+//  This code is released under GPLv3 license.
+//  see: https://www.gnu.org/licenses/gpl-3.0.en.html and https://www.fsf.org/
+
+#include <math.h>
+#include <stdlib.h>
+#include <vector>
+#include "check.h"
+#include "SoundResampler.h"
+
+#define OUT_RATE 16000
+#define SECONDS 1
+
+// converts a whole signal in chunks of random size (1..maxChunk input samples, 1..maxOut output samples)
+static std::vector<int16_t> convert(const std::vector<int16_t> & in, uint32_t inRate, uint8_t q, uint32_t maxChunk, uint32_t maxOut) {
+    SoundResampler r;
+    r.setup(inRate, OUT_RATE, q);
+    std::vector<int16_t> out;
+    int16_t buf[512];
+    uint32_t pos=0;
+    while (pos < in.size()) {
+        uint32_t n = 1 + rand() % maxChunk, consumed;
+        if (n > in.size()-pos) n = in.size()-pos;
+        uint32_t got = r.process(&in[pos], n, consumed, buf, 1 + rand() % maxOut);
+        out.insert(out.end(), buf, buf+got);
+        pos += consumed;
+    }
+    uint32_t got, consumed;
+    // output samples which lie before the next input sample are produced by the next call
+    while ((got = r.process(&in[0], 0, consumed, buf, 1 + rand() % maxOut)) > 0) out.insert(out.end(), buf, buf+got);
+    return (out);
+}
+
+static std::vector<int16_t> sine(uint32_t rate, double freq, uint32_t n) {
+    std::vector<int16_t> s(n);
+    for (uint32_t i=0; i<n; i++) s[i] = (int16_t) lround(16000*sin(2*M_PI*freq*i/rate));
+    return (s);
+}
+
+// SNR of the converted sine in dB (the delay of the filter is found by searching)
+static double snr(const std::vector<int16_t> & out, double freq) {
+    double best=-1000;
+    for (double delay=0; delay<16; delay+=0.125) {
+        double sig=0, err=0;
+        for (uint32_t i=100; i+100<out.size(); i++) {
+            double ref = 16000*sin(2*M_PI*freq*(i-delay)/OUT_RATE);
+            sig += ref*ref;
+            err += (out[i]-ref)*(out[i]-ref);
+        }
+        double db = 10*log10(sig/(err+1e-9));
+        if (db > best) best=db;
+    }
+    return (best);
+}
+
+int main() {
+    srand(1);
+    SoundResampler r;
+    r.setup(OUT_RATE, OUT_RATE, RESAMPLE_LINEAR);
+    CHECK(!r.active());
+
+    uint32_t rates[] = { 8000, 11025, 22050, 44100, 48000 };
+    for (uint8_t q=RESAMPLE_LINEAR; q<=RESAMPLE_FIR; q++) {
+        for (uint8_t i=0; i<5; i++) {
+            uint32_t n = rates[i]*SECONDS;
+            std::vector<int16_t> in = sine(rates[i], 440, n);
+            std::vector<int16_t> big = convert(in, rates[i], q, n, 512);
+            std::vector<int16_t> small = convert(in, rates[i], q, 7, 5);
+            // one output sample per step (+2 for the start and the end of the signal)
+            CHECK(labs((long)big.size() - (long)((uint64_t)n*OUT_RATE/rates[i])) <= 2);
+            CHECK(big == small);
+            double db = snr(big, 440);
+            printf("quality %d, %u Hz: %u -> %u samples, SNR %.1f dB\n", q, rates[i], n, (unsigned)big.size(), db);
+            CHECK(db > 35);
+        }
+    }
+
+    // a tone above the output nyquist frequency is attenuated by the FIR filter
+    std::vector<int16_t> in = sine(48000, 12000, 48000);
+    double linear=0, fir=0;
+    std::vector<int16_t> a = convert(in, 48000, RESAMPLE_LINEAR, 512, 512), b = convert(in, 48000, RESAMPLE_FIR, 512, 512);
+    for (uint32_t i=100; i<a.size(); i++) linear += (double)a[i]*a[i];
+    for (uint32_t i=100; i<b.size(); i++) fir += (double)b[i]*b[i];
+    printf("aliasing of 12 kHz: linear %.1f dB, FIR %.1f dB\n", 10*log10(linear/a.size()), 10*log10(fir/b.size()));
+    CHECK(fir < linear);
+    return (checkResult("test_resampler"));
+}
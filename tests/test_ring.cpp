@@ -0,0 +1,124 @@
+//
+//  test_ring - unit test of the lock-free ring buffer (SoundRing.h)
+//  part of the ESP32Sound library, https://github.com/ChrisVeigl/ESP32Sound
+//
+//  This code is released under GPLv3 license.
+//  see: https://www.gnu.org/licenses/gpl-3.0.en.html and https://www.fsf.org/
+
+#include <thread>
+#include "check.h"
+#include "SoundRing.h"
+
+#define STRESS_SAMPLES 2000000
+
+static void testBasics() {
+    SoundRing<int16_t> r;
+    CHECK_EQ(r.size(), 0);
+    CHECK(r.allocate(1000));
+    CHECK_EQ(r.size(), 1024);        // rounded up to a power of two
+    CHECK_EQ(r.available(), 0);
+    CHECK_EQ(r.space(), 1024);
+
+    int16_t in[1500], out=0;
+    for (int i=0; i<1500; i++) in[i]=i;
+    CHECK_EQ(r.write(in, 1500), 1024);   // only what fits
+    CHECK_EQ(r.space(), 0);
+    for (int i=0; i<1024; i++) {
+        CHECK(r.read(out));
+        if (out != i) { CHECK_EQ(out, i); break; }
+    }
+    CHECK(!r.read(out));
+}
+
+// the free-running indices wrap around the buffer end: chunks are split in two copies
+static void testWrap() {
+    SoundRing<uint8_t> r;
+    r.allocate(16);
+    uint8_t in[10], out[10];
+    uint8_t next=0, expect=0;
+    for (int round=0; round<100; round++) {
+        for (int i=0; i<10; i++) in[i]=next++;
+        CHECK_EQ(r.write(in, 10), 10);
+        uint32_t n, got=0;
+        while (got < 10) {
+            const uint8_t * p = r.readPtr(n);
+            CHECK(n > 0);
+            memcpy(out+got, p, n);
+            r.consume(n);
+            got+=n;
+        }
+        for (int i=0; i<10; i++) CHECK_EQ(out[i], expect++);
+    }
+    CHECK_EQ(r.available(), 0);
+}
+
+// writePtr()/commit() give the contiguous free space up to the buffer end
+static void testWritePtr() {
+    SoundRing<uint16_t> r;
+    r.allocate(8);
+    uint16_t in[6]={1,2,3,4,5,6}, v=0;
+    r.write(in, 6);
+    for (int i=0; i<6; i++) r.read(v);
+    uint32_t n;
+    uint16_t * p = r.writePtr(n);
+    CHECK_EQ(n, 2);                  // positions 6 and 7, then the wrap
+    p[0]=10; p[1]=11;
+    r.commit(2);
+    p = r.writePtr(n);
+    CHECK_EQ(n, 6);
+    p[0]=12;
+    r.commit(1);
+    CHECK_EQ(r.available(), 3);
+    for (int i=0; i<3; i++) { r.read(v); CHECK_EQ(v, 10+i); }
+
+    r.write(in, 4);
+    r.clear();
+    CHECK_EQ(r.available(), 0);
+    CHECK_EQ(r.space(), 8);
+
+    // clear() keeps the offset, reset() starts at the beginning of the buffer again
+    p = r.writePtr(n);
+    CHECK(n < 8);
+    r.reset();
+    p = r.writePtr(n);
+    CHECK_EQ(n, 8);
+}
+
+// one producer thread with chunks, one consumer thread reading single elements (like the timer ISR)
+static void testStress() {
+    SoundRing<uint32_t> r;
+    r.allocate(1024);
+    uint32_t errors=0, received=0;
+
+    std::thread consumer([&]() {
+        uint32_t expect=0, v=0;
+        while (expect < STRESS_SAMPLES) {
+            if (r.read(v)) {
+                if (v != expect) errors++;
+                expect++;
+            }
+            else std::this_thread::yield();   // the test may run on a single core
+        }
+        received=expect;
+    });
+    uint32_t chunk[97], next=0;
+    while (next < STRESS_SAMPLES) {
+        uint32_t n = STRESS_SAMPLES-next < 97 ? STRESS_SAMPLES-next : 97;
+        for (uint32_t i=0; i<n; i++) chunk[i]=next+i;
+        uint32_t w = r.write(chunk, n);
+        if (!w) std::this_thread::yield();
+        next+=w;
+    }
+    consumer.join();
+    CHECK_EQ(errors, 0);
+    CHECK_EQ(received, STRESS_SAMPLES);
+    CHECK_EQ(r.available(), 0);
+}
+
+int main() {
+    testBasics();
+    testWrap();
+    testWritePtr();
+    testStress();
+    return (checkResult("test_ring"));
+}
@@ -0,0 +1,75 @@
+//
+//  test_sd_stalls - the SD reader task with slow reads and read stalls (fake fs::FS with latency)
+//  part of the ESP32Sound library, https://github.com/ChrisVeigl/ESP32Sound
+//
+//  A 44.1kHz 16-bit stereo file (176KB/s, the worst case of the converter) is played at 16kHz.
+//  Every SD read takes 2ms, every 4th read stalls for 50ms more, like the garbage collection
+//  of an SD card. The sample buffer and the prefetch blocks must bridge the stalls: no underruns.
+//  Playback starts paused, so that the buffers are full before the first stall.
+//  Started at once, the music begins with the first decoded chunk: a stall right after it cannot
+//  be bridged. These start-up underruns are reported, they must be shorter than one stall and
+//  there must be none after the first second.
+//  As a control, stalls of 400ms (longer than the buffers) must give underruns.
+//
+//  This code is released under GPLv3 license.
+//  see: https://www.gnu.org/licenses/gpl-3.0.en.html and https://www.fsf.org/
+
+#include <unistd.h>
+#include "engine.h"
+
+#define RATE 16000
+#define FILE_RATE 44100
+
+// plays 3s of the file, started paused (full buffers) or at once; startUnderruns are the underruns of the first second
+static SoundStats play(fs::FS & sd, uint32_t stallUs, bool paused, uint32_t & startUnderruns) {
+    sd.setLatency(2000, 4, stallUs);
+    ESP32Sound.resetStats();
+    if (paused) ESP32Sound.pause();
+    soundHandle_t h = ESP32Sound.playSound(sd, "/music.wav");
+    CHECK(h != SOUND_NO_HANDLE);
+    if (paused) {
+        hostRun(RATE/2);
+        ESP32Sound.resume();
+    }
+    hostRun(RATE);
+    startUnderruns = ESP32Sound.getStats().underruns;
+    hostRun(RATE*2);
+    CHECK_EQ(ESP32Sound.getSoundState(h), SOUND_PLAYING);
+    SoundStats st = ESP32Sound.getStats();
+    ESP32Sound.stopSound();
+    hostRun(0);
+    printf("stalls of %u ms, %s: %u SD reads, slowest %u us, %u underruns (%u in the first second)\n",
+           stallUs/1000, paused ? "started paused" : "started at once", st.sdReads, st.sdReadMaxUs, 
+           st.underruns, startUnderruns);
+    return (st);
+}
+
+int main() {
+    std::string dir = tempDir();
+    CHECK(writeTestWav(dir + "/music.wav", FILE_RATE, 2, FILE_RATE*5, [](uint32_t i, uint16_t c) {
+        return ((int16_t) lround(8000*sin(2*M_PI*(c ? 330 : 220)*i/FILE_RATE)));
+    }));
+    fs::FS sd(dir.c_str());
+
+    ESP32Sound.setVerbosity(0);
+    ESP32Sound.begin(RATE);
+
+    uint32_t startUnderruns;
+    SoundStats st = play(sd, 50000, true, startUnderruns);
+    CHECK(st.sdReads > 100);
+    CHECK(st.sdReadMaxUs >= 52000);
+    CHECK_EQ(st.underruns, 0);
+
+    st = play(sd, 50000, false, startUnderruns);
+    CHECK(st.sdReadMaxUs >= 52000);
+    CHECK_EQ(st.underruns, startUnderruns);
+    CHECK(startUnderruns < RATE*52/1000);
+
+    st = play(sd, 400000, true, startUnderruns);
+    CHECK(st.underruns > 0);
+
+    CHECK_EQ(fs::FS::openFiles(), 0);
+    remove((dir + "/music.wav").c_str());
+    rmdir(dir.c_str());
+    return (checkResult("test_sd_stalls"));
+}
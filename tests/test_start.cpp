@@ -0,0 +1,134 @@
+//
+//  test_start - starting files: playSound(), preload() / play() and crossfadeTo()
+//  part of the ESP32Sound library, https://github.com/ChrisVeigl/ESP32Sound
+//
+//  The start functions return a handle at once, also while the reader task waits for a slow SD card:
+//  with SD latency (2ms per read, a stall of 30ms every 4th read) they must not let the virtual 
+//  time of the host simulation advance (a blocking call waits in virtual time).
+//  A preloaded file is played by play() from its buffers: without a fade the first output
+//  sample is the first sample of the file, with a fade the former file is crossfaded.
+//
+//  This code is released under GPLv3 license.
+//  see: https://www.gnu.org/licenses/gpl-3.0.en.html and https://www.fsf.org/
+
+#include <unistd.h>
+#include "engine.h"
+
+#define RATE 16000
+#define LEVEL 12000
+
+static double mean(const std::vector<uint8_t> & out, uint32_t from, uint32_t n) {
+    double sum=0;
+    for (uint32_t i=from; i<from+n; i++) sum+=out[i];
+    return (sum/n);
+}
+
+// the virtual time (in us) which passed during the call
+template <typename F> static uint32_t blocked(F call) {
+    uint64_t t = simNowNs();
+    call();
+    return ((simNowNs()-t) / 1000);
+}
+
+static void testNoBlocking(fs::FS & sd) {
+    sd.setLatency(2000, 4, 30000);
+    uint32_t worst = 0, calls = 0;
+    for (uint32_t k=0; k<8; k++) {
+        // preload while a file is played, the reader task reads both
+        soundHandle_t a = ESP32Sound.playSound(sd, "/music1.wav");
+        CHECK(a != SOUND_NO_HANDLE);
+        hostRun(RATE/4 + k*397);
+        soundHandle_t b = SOUND_NO_HANDLE;
+        worst = std::max(worst, blocked([&] { b = ESP32Sound.preload(sd, "/music2.wav"); }));
+        CHECK(b != SOUND_NO_HANDLE);
+        hostRun(k*211);
+        // both streams are busy: the preloaded file (not the current one) is stopped without waiting 
+        // for the stream task, its stream is reused
+        soundHandle_t c = SOUND_NO_HANDLE;
+        worst = std::max(worst, blocked([&] { c = ESP32Sound.crossfadeTo(sd, "/music1.wav", 500); }));
+        CHECK(c != SOUND_NO_HANDLE);
+        CHECK_EQ(ESP32Sound.getSoundState(b), SOUND_FINISHED);
+        hostRun(RATE*3/2);
+        CHECK_EQ(ESP32Sound.getSoundState(a), SOUND_FINISHED);
+        CHECK_EQ(ESP32Sound.getSoundState(c), SOUND_PLAYING);
+        ESP32Sound.stopSound();
+        hostRun(0);
+        // playSound while the reader reads a preloaded file
+        b = ESP32Sound.preload(sd, "/music2.wav");
+        hostRun(k*173);
+        worst = std::max(worst, blocked([&] { a = ESP32Sound.playSound(sd, "/music1.wav"); }));
+        CHECK(a != SOUND_NO_HANDLE);
+        hostRun(RATE/4);
+        CHECK_EQ(ESP32Sound.getSoundState(a), SOUND_PLAYING);
+        CHECK_EQ(ESP32Sound.getSoundState(b), SOUND_PRELOADED);
+        ESP32Sound.stopSound();
+        hostRun(0);
+        calls += 3;
+    }
+    printf("%u calls of playSound(), preload() and crossfadeTo() with SD stalls: blocked at most %u us\n", calls, worst);
+    CHECK_EQ(worst, 0);
+    sd.setLatency(0);
+}
+
+static void testPreload(fs::FS & sd) {
+    std::vector<uint8_t> & out = hostOutput();
+    soundHandle_t a = ESP32Sound.preload(sd, "/plus.wav");
+    CHECK(a != SOUND_NO_HANDLE);
+    CHECK(!ESP32Sound.play(a+1));                  // not a handle of a preloaded file
+    hostRun(RATE/4);
+    CHECK_EQ(ESP32Sound.getSoundState(a), SOUND_PRELOADED);
+    CHECK(!ESP32Sound.isPlaying());
+    out.clear();
+    CHECK(ESP32Sound.play(a));
+    hostRun(RATE/2);
+    CHECK_EQ(ESP32Sound.getSoundState(a), SOUND_PLAYING);
+    CHECK_EQ(ESP32Sound.getStats().underruns, 0);
+    double hi = mean(out, 0, RATE/2);
+    printf("preloaded file: first sample %u, level %.2f\n", out[0], hi);
+    CHECK(fabs(out[0] - hi) <= 1);                  // from the first sample (no SD access)
+    CHECK(hi - 127 > 30);
+    CHECK(!ESP32Sound.play(a));                    // already playing
+
+    // a second preloaded file with a crossfade of 500 ms
+    soundHandle_t b = ESP32Sound.preload(sd, "/minus.wav");
+    hostRun(RATE/4);
+    CHECK_EQ(ESP32Sound.getSoundState(b), SOUND_PRELOADED);
+    CHECK_EQ(ESP32Sound.getSoundState(a), SOUND_PLAYING);
+    uint32_t from = out.size();
+    CHECK(ESP32Sound.play(b, 500));
+    hostRun(RATE);
+    double mid = mean(out, from+RATE/4-RATE/50, RATE/25), lo = mean(out, out.size()-RATE/4, RATE/4);
+    printf("crossfade to a preloaded file: %.2f -> %.2f (middle %.2f)\n", hi, lo, mid);
+    CHECK(fabs(out[from] - hi) <= 1);
+    CHECK(fabs(mid - 127) < 3);
+    CHECK(fabs((127-lo) - (hi-127)) < 2);
+    CHECK_EQ(ESP32Sound.getSoundState(a), SOUND_FINISHED);
+    CHECK_EQ(ESP32Sound.getSoundState(b), SOUND_PLAYING);
+    ESP32Sound.stopSound();
+    hostRun(0);
+}
+
+int main() {
+    std::string dir = tempDir();
+    fs::FS sd(dir.c_str());
+    auto constant = [](int16_t v) { return [v](uint32_t, uint16_t) { return (v); }; };
+    CHECK(writeTestWav(dir + "/plus.wav", RATE, 1, RATE*5, constant(LEVEL)));
+    CHECK(writeTestWav(dir + "/minus.wav", RATE, 1, RATE*5, constant(-LEVEL)));
+    for (uint8_t i=1; i<=2; i++)
+        CHECK(writeTestWav(dir + "/music" + (char)('0'+i) + ".wav", 44100, 2, 44100*5, [i](uint32_t n, uint16_t c) {
+            return ((int16_t) lround(8000*sin(2*M_PI*(c ? 330 : 220)*i*n/44100)));
+        }));
+
+    ESP32Sound.setVerbosity(0);
+    ESP32Sound.begin(RATE);
+    ESP32Sound.setSoundVolume(100);
+    hostRun(0);
+    testPreload(sd);
+    testNoBlocking(sd);
+    CHECK_EQ(fs::FS::openFiles(), 0);
+
+    const char * files[] = { "/plus.wav", "/minus.wav", "/music1.wav", "/music2.wav" };
+    for (uint8_t i=0; i<4; i++) sd.remove(files[i]);
+    rmdir(dir.c_str());
+    return (checkResult("test_start"));
+}
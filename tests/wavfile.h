@@ -0,0 +1,89 @@
+//
+//  wavfile.h - loads and writes .wav files for the host tests and benchmarks
+//  part of the ESP32Sound library, https://github.com/ChrisVeigl/ESP32Sound
+//
+//  This code is released under GPLv3 license.
+//  see: https://www.gnu.org/licenses/gpl-3.0.en.html and https://www.fsf.org/
+
+#ifndef _wavfile_H_
+#define _wavfile_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+struct WavFile {
+    uint16_t format;
+    uint16_t channels;
+    uint32_t samplingRate;
+    uint16_t blockAlign;
+    uint16_t bits;
+    std::vector<uint8_t> data;     // contents of the data chunk
+};
+
+static inline uint32_t wavGet32(const uint8_t * p) { return (p[0] | (p[1]<<8) | (p[2]<<16) | ((uint32_t)p[3]<<24)); }
+static inline uint16_t wavGet16(const uint8_t * p) { return (p[0] | (p[1]<<8)); }
+static inline void wavPut32(uint8_t * p, uint32_t v) { for (int i=0; i<4; i++) p[i]=v>>(8*i); }
+static inline void wavPut16(uint8_t * p, uint16_t v) { p[0]=v; p[1]=v>>8; }
+
+// reads the fmt and data chunks of a .wav file, returns false if this failed
+static inline bool loadWav(const char * path, WavFile & w) {
+    FILE * f = fopen(path, "rb");
+    if (!f) return (false);
+    std::vector<uint8_t> buf;
+    uint8_t tmp[4096];
+    size_t n;
+    while ((n = fread(tmp, 1, sizeof(tmp), f)) > 0) buf.insert(buf.end(), tmp, tmp+n);
+    fclose(f);
+    if ((buf.size() < 12) || memcmp(&buf[0], "RIFF", 4) || memcmp(&buf[8], "WAVE", 4)) return (false);
+    bool fmt=false;
+    for (size_t pos=12; pos+8 <= buf.size(); ) {
+        uint32_t len = wavGet32(&buf[pos+4]);
+        const uint8_t * c = &buf[pos+8];
+        if ((!memcmp(&buf[pos], "fmt ", 4)) && (len >= 16)) {
+            w.format = wavGet16(c);
+            w.channels = wavGet16(c+2);
+            w.samplingRate = wavGet32(c+4);
+            w.blockAlign = wavGet16(c+12);
+            w.bits = wavGet16(c+14);
+            fmt=true;
+        }
+        else if (!memcmp(&buf[pos], "data", 4)) {
+            if (len > buf.size()-pos-8) len = buf.size()-pos-8;
+            w.data.assign(c, c+len);
+            return (fmt);
+        }
+        pos += 8 + len + (len & 1);
+    }
+    return (false);
+}
+
+// the 44-byte header of a PCM .wav file
+static inline void wavHeader(uint8_t * h, uint32_t rate, uint16_t bits, uint16_t channels, uint32_t dataSize) {
+    memcpy(h, "RIFF", 4);
+    wavPut32(h+4, dataSize+36);
+    memcpy(h+8, "WAVEfmt ", 8);
+    wavPut32(h+16, 16);
+    wavPut16(h+20, 1);
+    wavPut16(h+22, channels);
+    wavPut32(h+24, rate);
+    wavPut32(h+28, rate*channels*(bits/8));
+    wavPut16(h+32, channels*(bits/8));
+    wavPut16(h+34, bits);
+    memcpy(h+36, "data", 4);
+    wavPut32(h+40, dataSize);
+}
+
+// writes a PCM .wav file, returns false if this failed
+static inline bool saveWav(const char * path, uint32_t rate, uint16_t bits, uint16_t channels, const void * data, uint32_t size) {
+    FILE * f = fopen(path, "wb");
+    if (!f) return (false);
+    uint8_t h[44];
+    wavHeader(h, rate, bits, channels, size);
+    bool ok = (fwrite(h, 1, 44, f) == 44) && (fwrite(data, 1, size, f) == size);
+    fclose(f);
+    return (ok);
+}
+
+#endif